@@ -0,0 +1,326 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "analysis_db.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "board.h"
+#include "book.h"
+#include "constants.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Zagreus {
+int scoreToAnalysisDB(const int score, const int ply) {
+    if (score >= MATE_SCORE - MAX_PLIES) {
+        return score + ply;
+    }
+
+    if (score <= -MATE_SCORE + MAX_PLIES) {
+        return score - ply;
+    }
+
+    return score;
+}
+
+int scoreFromAnalysisDB(const int score, const int ply) {
+    if (score >= MATE_SCORE - MAX_PLIES) {
+        return score - ply;
+    }
+
+    if (score <= -MATE_SCORE + MAX_PLIES) {
+        return score + ply;
+    }
+
+    return score;
+}
+
+/**
+ * \brief Creates an empty database file.
+ */
+static bool createFile(const std::string& path, const uint64_t slotCount) {
+    AnalysisDBFileHeader header{};
+    std::error_code error{};
+
+    header.slotCount = slotCount;
+
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+        if (!file || !file.write(reinterpret_cast<const char*>(&header), sizeof(header))) {
+            return false;
+        }
+    }
+
+    // Grows the file with zeros, which are empty slots
+    std::filesystem::resize_file(path, sizeof(header) + slotCount * sizeof(AnalysisRecord), error);
+    return !error;
+}
+
+AnalysisDatabase::~AnalysisDatabase() {
+    close();
+}
+
+AnalysisDBFileHeader& AnalysisDatabase::getHeader() const {
+    return *reinterpret_cast<AnalysisDBFileHeader*>(reinterpret_cast<uint8_t*>(records) - sizeof(AnalysisDBFileHeader));
+}
+
+bool AnalysisDatabase::map() {
+    AnalysisDBFileHeader header{};
+    const AnalysisDBFileHeader expectedHeader{};
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return false;
+    }
+
+    const uint64_t expectedFileSize = sizeof(header) + header.slotCount * sizeof(AnalysisRecord);
+    std::error_code error{};
+
+    if (std::memcmp(header.magic, expectedHeader.magic, sizeof(header.magic)) != 0
+        || header.version != ANALYSIS_DB_VERSION || header.recordSize != sizeof(AnalysisRecord)
+        || !std::has_single_bit(header.slotCount) || std::filesystem::file_size(path, error) != expectedFileSize
+        || error) {
+        return false;
+    }
+
+#if defined(_WIN32)
+    fileData.resize(expectedFileSize);
+    file.seekg(0);
+
+    if (!file.read(reinterpret_cast<char*>(fileData.data()), static_cast<std::streamsize>(expectedFileSize))) {
+        fileData.clear();
+        return false;
+    }
+
+    records = reinterpret_cast<AnalysisRecord*>(fileData.data() + sizeof(header));
+#else
+    const int fileDescriptor = ::open(path.c_str(), O_RDWR);
+
+    if (fileDescriptor == -1) {
+        return false;
+    }
+
+    // A shared mapping, so stored records are written to the file by the kernel
+    void* memory = mmap(nullptr, expectedFileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    ::close(fileDescriptor);
+
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+
+    mappedFile = memory;
+    mappedFileSize = expectedFileSize;
+    records = reinterpret_cast<AnalysisRecord*>(static_cast<uint8_t*>(memory) + sizeof(header));
+#endif
+
+    slotCount = header.slotCount;
+    return true;
+}
+
+bool AnalysisDatabase::open(const std::string& path, const uint64_t minimumSlots) {
+    close();
+    this->path = path;
+
+    if (!std::filesystem::exists(path)
+        && !createFile(path, std::bit_ceil(std::max(minimumSlots, ANALYSIS_DB_MIN_SLOTS)))) {
+        return false;
+    }
+
+    return map();
+}
+
+void AnalysisDatabase::close() {
+#if defined(_WIN32)
+    if (!fileData.empty()) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(fileData.data()), static_cast<std::streamsize>(fileData.size()));
+    }
+#else
+    if (mappedFile != nullptr) {
+        msync(mappedFile, mappedFileSize, MS_SYNC);
+        munmap(mappedFile, mappedFileSize);
+    }
+#endif
+
+    mappedFile = nullptr;
+    mappedFileSize = 0;
+    fileData.clear();
+    records = nullptr;
+    slotCount = 0;
+}
+
+uint64_t AnalysisDatabase::getRecordCount() const {
+    return isOpen() ? getHeader().recordCount : 0;
+}
+
+bool AnalysisDatabase::probe(const uint64_t key, const uint64_t verificationKey, AnalysisRecord& record) const {
+    if (!isOpen()) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < ANALYSIS_DB_PROBE_DISTANCE; i++) {
+        const AnalysisRecord& slot = records[(key + i) & (slotCount - 1)];
+
+        if (slot.depth == 0) {
+            return false;
+        }
+
+        if (slot.key == key && slot.verificationKey == verificationKey) {
+            record = slot;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void AnalysisDatabase::insert(const AnalysisRecord& record) {
+    for (uint64_t i = 0; i < ANALYSIS_DB_PROBE_DISTANCE; i++) {
+        AnalysisRecord& slot = records[(record.key + i) & (slotCount - 1)];
+
+        if (slot.depth == 0) {
+            slot = record;
+            getHeader().recordCount += 1;
+            return;
+        }
+
+        if (slot.key == record.key && slot.verificationKey == record.verificationKey) {
+            if (record.depth > slot.depth || (record.depth == slot.depth && record.nodes >= slot.nodes)) {
+                slot = record;
+            }
+
+            return;
+        }
+    }
+
+    // No free slot near the home slot, so the table is too crowded
+    if (resize(slotCount * 2)) {
+        insert(record);
+    }
+}
+
+bool AnalysisDatabase::resize(const uint64_t newSlotCount) {
+    std::vector<AnalysisRecord> storedRecords{};
+
+    forEachRecord([&storedRecords](const AnalysisRecord& record) { storedRecords.push_back(record); });
+
+    const std::string databasePath = path;
+    const std::string temporaryPath = path + ".tmp";
+    AnalysisDatabase resizedDatabase{};
+    std::error_code error{};
+
+    if (!createFile(temporaryPath, newSlotCount) || !resizedDatabase.open(temporaryPath)) {
+        return false;
+    }
+
+    for (const AnalysisRecord& record : storedRecords) {
+        resizedDatabase.insert(record);
+    }
+
+    resizedDatabase.close();
+    close();
+    std::filesystem::rename(temporaryPath, databasePath, error);
+    path = databasePath;
+    return !error && map();
+}
+
+bool AnalysisDatabase::store(const AnalysisRecord& record) {
+    if (!isOpen() || record.depth == 0) {
+        return false;
+    }
+
+    // Keep the table at most 3/4 full, so the records stay close to their home slot
+    if ((getRecordCount() + 1) * 4 > slotCount * 3 && !resize(slotCount * 2)) {
+        return false;
+    }
+
+    insert(record);
+    return isOpen();
+}
+
+bool AnalysisDatabase::store(const Board& board, const int depth, const int score, const uint64_t nodes,
+                             const PvLine& pvLine) {
+    AnalysisRecord record{};
+
+    record.key = board.getZobristHash();
+    record.verificationKey = getPolyglotKey(board);
+    record.nodes = nodes;
+    record.score = scoreToAnalysisDB(score, board.getPly());
+    record.depth = static_cast<uint16_t>(depth);
+    record.pvLength = static_cast<uint16_t>(std::min(pvLine.moveCount, ANALYSIS_DB_MAX_PV));
+    std::copy_n(pvLine.moves, record.pvLength, record.pv.begin());
+    return store(record);
+}
+
+void AnalysisDatabase::forEachRecord(const std::function<void(const AnalysisRecord&)>& callback) const {
+    for (uint64_t i = 0; i < slotCount; i++) {
+        if (records[i].depth != 0) {
+            callback(records[i]);
+        }
+    }
+}
+
+bool AnalysisDatabase::merge(const std::string& outputPath, const std::vector<std::string>& inputPaths) {
+    std::vector<AnalysisRecord> storedRecords{};
+
+    for (const std::string& inputPath : inputPaths) {
+        AnalysisDatabase input{};
+
+        if (!std::filesystem::exists(inputPath) || !input.open(inputPath)) {
+            return false;
+        }
+
+        input.forEachRecord([&storedRecords](const AnalysisRecord& record) { storedRecords.push_back(record); });
+    }
+
+    // At most half full, so every record has room near its home slot
+    const uint64_t newSlotCount = std::bit_ceil(std::max(storedRecords.size() * 2, ANALYSIS_DB_MIN_SLOTS));
+    const std::string temporaryPath = outputPath + ".tmp";
+    AnalysisDatabase output{};
+    std::error_code error{};
+
+    if (!createFile(temporaryPath, newSlotCount) || !output.open(temporaryPath)) {
+        return false;
+    }
+
+    for (const AnalysisRecord& record : storedRecords) {
+        output.insert(record);
+    }
+
+    output.close();
+    std::filesystem::rename(temporaryPath, outputPath, error);
+    return !error;
+}
+
+AnalysisDatabase* AnalysisDatabase::getAnalysisDatabase() {
+    static AnalysisDatabase instance{};
+    return &instance;
+}
+} // namespace Zagreus
@@ -0,0 +1,168 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "move.h"
+
+namespace Zagreus {
+class Board;
+
+constexpr uint32_t ANALYSIS_DB_VERSION = 1;
+constexpr int ANALYSIS_DB_MAX_PV = 48;
+constexpr uint64_t ANALYSIS_DB_MIN_SLOTS = 4096;
+// The amount of slots after the home slot of a key that may hold its record
+constexpr uint64_t ANALYSIS_DB_PROBE_DISTANCE = 16;
+
+/**
+ * \brief A finished search of a position. The zobrist hash and a verification key with independent constants (the
+ * Polyglot key) make a false match practically impossible. Mate scores are stored relative to the position.
+ */
+struct AnalysisRecord {
+    uint64_t key = 0;
+    uint64_t verificationKey = 0;
+    uint64_t nodes = 0;
+    int32_t score = 0;
+    // 0 marks an empty slot, every search has a depth of at least 1
+    uint16_t depth = 0;
+    uint16_t pvLength = 0;
+    std::array<Move, ANALYSIS_DB_MAX_PV> pv{};
+
+    [[nodiscard]] Move getBestMove() const {
+        return pvLength > 0 ? pv[0] : NO_MOVE;
+    }
+};
+
+static_assert(sizeof(AnalysisRecord) == 128);
+
+/**
+ * \brief The header of an analysis database file, followed by slotCount records.
+ */
+struct AnalysisDBFileHeader {
+    char magic[8]{'Z', 'A', 'G', 'R', 'A', 'D', 'B', '\0'};
+    uint32_t version = ANALYSIS_DB_VERSION;
+    uint32_t recordSize = sizeof(AnalysisRecord);
+    uint64_t slotCount = 0;
+    uint64_t recordCount = 0;
+};
+
+/**
+ * \brief A persistent store of finished searches. The file is memory mapped, so stored results reach the disk without
+ * explicit writes and opening even a large database is instant. The records are kept in an open addressing hash
+ * table that doubles in size when it gets full.
+ */
+class AnalysisDatabase {
+private:
+    std::string path{};
+    AnalysisRecord* records = nullptr;
+    uint64_t slotCount = 0;
+    void* mappedFile = nullptr;
+    uint64_t mappedFileSize = 0;
+    // Only used when the file can't be memory mapped, written back when closing
+    std::vector<uint8_t> fileData{};
+
+    [[nodiscard]] AnalysisDBFileHeader& getHeader() const;
+
+    bool map();
+
+    bool resize(uint64_t newSlotCount);
+
+    void insert(const AnalysisRecord& record);
+
+public:
+    AnalysisDatabase() = default;
+
+    ~AnalysisDatabase();
+
+    AnalysisDatabase(const AnalysisDatabase&) = delete;
+
+    AnalysisDatabase& operator=(const AnalysisDatabase&) = delete;
+
+    /**
+     * \brief Opens a database file, or creates it if it does not exist. Closes the database that was open before.
+     * \param path The path of the file.
+     * \param minimumSlots The minimum amount of slots of a new file.
+     * \return True if the database was opened, false otherwise.
+     */
+    bool open(const std::string& path, uint64_t minimumSlots = ANALYSIS_DB_MIN_SLOTS);
+
+    /**
+     * \brief Writes all changes to the file and closes the database.
+     */
+    void close();
+
+    [[nodiscard]] bool isOpen() const {
+        return records != nullptr;
+    }
+
+    [[nodiscard]] uint64_t getRecordCount() const;
+
+    /**
+     * \brief Looks up the stored search of a position.
+     * \param key The zobrist hash of the position.
+     * \param verificationKey The verification key of the position.
+     * \param record Set to the stored record if it was found.
+     * \return True if the position was found, false otherwise.
+     */
+    bool probe(uint64_t key, uint64_t verificationKey, AnalysisRecord& record) const;
+
+    /**
+     * \brief Stores a search. A stored search of the same position is only replaced by a deeper one, or by one of the
+     * same depth that searched at least as many nodes.
+     * \return True if the record was stored, false otherwise.
+     */
+    bool store(const AnalysisRecord& record);
+
+    /**
+     * \brief Stores the search of the root position of a board.
+     */
+    bool store(const Board& board, int depth, int score, uint64_t nodes, const PvLine& pvLine);
+
+    /**
+     * \brief Calls a function for every stored record.
+     */
+    void forEachRecord(const std::function<void(const AnalysisRecord&)>& callback) const;
+
+    /**
+     * \brief Merges databases into one, keeping the deepest search of every position. The output is written with the
+     * smallest size that fits all records, so merging a single database into itself compacts it.
+     * \param outputPath The path of the merged database. May be one of the inputs.
+     * \param inputPaths The paths of the databases to merge.
+     * \return True if all databases were merged, false otherwise.
+     */
+    static bool merge(const std::string& outputPath, const std::vector<std::string>& inputPaths);
+
+    static AnalysisDatabase* getAnalysisDatabase();
+};
+
+/**
+ * \brief Converts a search score to the score that is stored, and back. Mate scores use the game ply, so they are stored
+ * as the distance to mate from the position.
+ */
+int scoreToAnalysisDB(int score, int ply);
+
+int scoreFromAnalysisDB(int score, int ply);
+} // namespace Zagreus
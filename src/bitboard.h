@@ -364,6 +364,50 @@ inline uint64_t blackDoublePushablePawns(const uint64_t bb, const uint64_t empty
     return blackPushablePawns(bb, emptyRank6);
 }
 
+/**
+ * \brief Fills all squares north of the set bits, including the set bits themselves.
+ * \param bb The bitboard to fill.
+ * \return The filled bitboard.
+ */
+inline uint64_t northFill(uint64_t bb) {
+    bb |= bb << 8;
+    bb |= bb << 16;
+    bb |= bb << 32;
+    return bb;
+}
+
+/**
+ * \brief Fills all squares south of the set bits, including the set bits themselves.
+ * \param bb The bitboard to fill.
+ * \return The filled bitboard.
+ */
+inline uint64_t southFill(uint64_t bb) {
+    bb |= bb >> 8;
+    bb |= bb >> 16;
+    bb |= bb >> 32;
+    return bb;
+}
+
+/**
+ * \brief Calculates the attack span of white pawns, which are all squares the pawns attack now or could attack after
+ * advancing.
+ * \param bb The bitboard representing the pawns.
+ * \return The bitboard representing the attack span.
+ */
+inline uint64_t calculateWhitePawnAttackSpan(const uint64_t bb) {
+    return calculateWhitePawnAttacks(northFill(bb));
+}
+
+/**
+ * \brief Calculates the attack span of black pawns, which are all squares the pawns attack now or could attack after
+ * advancing.
+ * \param bb The bitboard representing the pawns.
+ * \return The bitboard representing the attack span.
+ */
+inline uint64_t calculateBlackPawnAttackSpan(const uint64_t bb) {
+    return calculateBlackPawnAttacks(southFill(bb));
+}
+
 /**
  * \brief Calculates the attacks for knights.
  * \param bb The bitboard representing the knights.
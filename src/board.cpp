@@ -20,6 +20,8 @@
 
 #include "board.h"
 #include <ctype.h>
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <string_view>
 #include "bitwise.h"
@@ -29,6 +31,80 @@
 namespace Zagreus {
 static uint64_t zobristConstants[781]{};
 
+// Cuckoo tables of every reversible move of a non-pawn piece, indexed by the zobrist key difference the move causes
+constexpr int CUCKOO_TABLE_SIZE = 8192;
+static uint64_t cuckooKeys[CUCKOO_TABLE_SIZE]{};
+static Move cuckooMoves[CUCKOO_TABLE_SIZE]{};
+
+static int cuckooHash1(const uint64_t key) {
+    return static_cast<int>(key & (CUCKOO_TABLE_SIZE - 1));
+}
+
+static int cuckooHash2(const uint64_t key) {
+    return static_cast<int>((key >> 16) & (CUCKOO_TABLE_SIZE - 1));
+}
+
+/**
+ * \brief Checks if a piece can move between two squares on an empty board.
+ */
+static bool canPieceReach(const PieceType pieceType, const int fromSquare, const int toSquare) {
+    const int fileDistance = std::abs(fromSquare % 8 - toSquare % 8);
+    const int rankDistance = std::abs(fromSquare / 8 - toSquare / 8);
+    const bool isStraight = fileDistance == 0 || rankDistance == 0;
+    const bool isDiagonal = fileDistance == rankDistance;
+
+    switch (pieceType) {
+        case KNIGHT:
+            return fileDistance * rankDistance == 2;
+        case BISHOP:
+            return isDiagonal;
+        case ROOK:
+            return isStraight;
+        case QUEEN:
+            return isStraight || isDiagonal;
+        case KING:
+            return std::max(fileDistance, rankDistance) == 1;
+        default:
+            return false;
+    }
+}
+
+/**
+ * \brief Fills the cuckoo tables. Every move gets one of two slots, an entry that is in the way is moved to its other
+ * slot.
+ */
+static void initializeCuckooTables() {
+    std::ranges::fill(cuckooKeys, 0);
+    std::ranges::fill(cuckooMoves, NO_MOVE);
+
+    for (Piece piece = WHITE_KNIGHT; piece <= BLACK_KING; piece++) {
+        for (int fromSquare = 0; fromSquare < SQUARES; fromSquare++) {
+            for (int toSquare = fromSquare + 1; toSquare < SQUARES; toSquare++) {
+                if (!canPieceReach(getPieceType(piece), fromSquare, toSquare)) {
+                    continue;
+                }
+
+                Move move = encodeMove(fromSquare, toSquare);
+                uint64_t key = zobristConstants[ZOBRIST_PIECE_START_INDEX + piece * SQUARES + fromSquare]
+                               ^ zobristConstants[ZOBRIST_PIECE_START_INDEX + piece * SQUARES + toSquare]
+                               ^ zobristConstants[ZOBRIST_SIDE_TO_MOVE_INDEX];
+                int index = cuckooHash1(key);
+
+                while (true) {
+                    std::swap(cuckooKeys[index], key);
+                    std::swap(cuckooMoves[index], move);
+
+                    if (move == NO_MOVE) {
+                        break;
+                    }
+
+                    index = index == cuckooHash1(key) ? cuckooHash2(key) : cuckooHash1(key);
+                }
+            }
+        }
+    }
+}
+
 /**
  * \brief Initializes the Zobrist constants.
  */
@@ -44,6 +120,8 @@ void initZobristConstants() {
             zobrist = rng();
         }
     }
+
+    initializeCuckooTables();
 }
 
 /**
@@ -55,6 +133,47 @@ constexpr uint64_t getZobristConstant(const int index) {
     return zobristConstants[index];
 }
 
+bool Board::hasUpcomingRepetition(const int searchPly) const {
+    int oldestDistance = std::min<int>(halfMoveClock, ply);
+
+    // Positions before a null move were never on the board in this line
+    for (int distance = 1; distance <= oldestDistance; distance++) {
+        if (history[ply - distance].move == NO_MOVE) {
+            oldestDistance = distance - 1;
+            break;
+        }
+    }
+
+    // A single move of the side to move can only go back to a position with the other side to move
+    for (int distance = 3; distance <= oldestDistance; distance += 2) {
+        // Positions before the root can't be repeated in this search
+        if (distance >= searchPly) {
+            break;
+        }
+
+        const uint64_t moveKey = zobristHash ^ history[ply - distance].zobristHash;
+        int index = cuckooHash1(moveKey);
+
+        if (cuckooKeys[index] != moveKey) {
+            index = cuckooHash2(moveKey);
+
+            if (cuckooKeys[index] != moveKey) {
+                continue;
+            }
+        }
+
+        const Move move = cuckooMoves[index];
+        const Square fromSquare = getFromSquare(move);
+        const Square toSquare = getToSquare(move);
+
+        if (!(getSquaresBetween(fromSquare, toSquare) & occupied)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 /**
  * \brief Checks if the current position is legal for the given color.
  * \tparam movedColor The color of the player who just moved.
@@ -150,6 +269,16 @@ template bool Board::canCastle<BLACK_QUEENSIDE>() const;
  * \return A bitboard representing the attackers.
  */
 uint64_t Board::getSquareAttackers(const Square square) const {
+    return getSquareAttackers(square, occupied);
+}
+
+/**
+ * \brief Retrieves the attackers of a given square, with sliding attacks computed for the given occupancy.
+ * \param square The square index (0-63).
+ * \param occupancy The occupancy bitboard that blocks sliding pieces.
+ * \return A bitboard representing the attackers.
+ */
+uint64_t Board::getSquareAttackers(const Square square, const uint64_t occupancy) const {
     assert(square < SQUARES);
     const uint64_t knights = getPieceBoard<WHITE_KNIGHT>() | getPieceBoard<BLACK_KNIGHT>();
     const uint64_t kings = getPieceBoard<WHITE_KING>() | getPieceBoard<BLACK_KING>();
@@ -162,8 +291,8 @@ uint64_t Board::getSquareAttackers(const Square square) const {
            | (getPawnAttacks<BLACK>(square) & getPieceBoard<WHITE_PAWN>())
            | (getKnightAttacks(square) & knights)
            | (getKingAttacks(square) & kings)
-           | (getBishopAttacks(square, occupied) & bishopsQueens)
-           | (getRookAttacks(square, occupied) & rooksQueens);
+           | (getBishopAttacks(square, occupancy) & bishopsQueens)
+           | (getRookAttacks(square, occupancy) & rooksQueens);
 }
 
 /**
@@ -177,6 +306,9 @@ void Board::reset() {
     this->sideToMove = WHITE;
     this->occupied = 0;
     this->zobristHash = 0;
+    this->pawnZobristHash = 0;
+    this->pstScores = {};
+    this->phaseMaterial = 0;
     this->ply = 0;
     this->fullmoveClock = 1;
     this->halfMoveClock = 0;
@@ -188,6 +320,42 @@ void Board::reset() {
     std::ranges::fill(bitboards, 0);
     std::ranges::fill(colorBoards, 0);
     std::ranges::fill(history, BoardState{});
+
+    if (accumulatorStack) {
+        accumulatorStack->reset(*this);
+    }
+}
+
+/**
+ * \brief Copies the complete state of another board, including its history, into this board.
+ * \param other The board to copy from.
+ */
+void Board::copyFrom(const Board& other) {
+    this->board = other.board;
+    this->bitboards = other.bitboards;
+    this->colorBoards = other.colorBoards;
+    this->history = other.history;
+    this->previousPvLine = other.previousPvLine;
+    this->sideToMove = other.sideToMove;
+    this->occupied = other.occupied;
+    this->zobristHash = other.zobristHash;
+    this->pawnZobristHash = other.pawnZobristHash;
+    this->pstScores = other.pstScores;
+    this->phaseMaterial = other.phaseMaterial;
+    this->previousMove = other.previousMove;
+    this->ply = other.ply;
+    this->fullmoveClock = other.fullmoveClock;
+    this->halfMoveClock = other.halfMoveClock;
+    this->castlingRights = other.castlingRights;
+    this->enPassantSquare = other.enPassantSquare;
+}
+
+void Board::setAccumulatorStack(AccumulatorStack* stack) {
+    accumulatorStack = stack;
+
+    if (accumulatorStack) {
+        accumulatorStack->reset(*this);
+    }
 }
 
 /**
@@ -216,9 +384,11 @@ bool Board::isDraw() const {
     }
 
     const uint64_t zobristHash = getZobristHash();
+    // Positions before the last capture or pawn move can't repeat, and a repetition takes at least 4 plies
+    const int oldestPly = std::max(0, ply - halfMoveClock);
 
     // 3-fold repetition
-    for (int i = ply - 2; i >= 0; i -= 2) {
+    for (int i = ply - 4; i >= oldestPly; i -= 2) {
         if (history[i].zobristHash == zobristHash) {
             return true;
         }
@@ -267,6 +437,101 @@ uint64_t Board::getZobristHash() const {
     return this->zobristHash;
 }
 
+/**
+ * \brief Returns the castling rights that are lost when a piece moves from or to the given square.
+ */
+static uint8_t getCastlingRightsLost(const uint8_t square) {
+    switch (square) {
+        case A1:
+            return WHITE_QUEENSIDE;
+        case H1:
+            return WHITE_KINGSIDE;
+        case E1:
+            return WHITE_CASTLING;
+        case A8:
+            return BLACK_QUEENSIDE;
+        case H8:
+            return BLACK_KINGSIDE;
+        case E8:
+            return BLACK_CASTLING;
+        default:
+            return 0;
+    }
+}
+
+uint64_t Board::getZobristHashAfterMove(const Move move) const {
+    const uint8_t fromSquare = getFromSquare(move);
+    const uint8_t toSquare = getToSquare(move);
+    const MoveType moveType = getMoveType(move);
+    const Piece movedPiece = getPieceOnSquare(fromSquare);
+    const Piece capturedPiece = getPieceOnSquare(toSquare);
+    Piece placedPiece = movedPiece;
+    uint64_t hash = zobristHash ^ getZobristConstant(ZOBRIST_SIDE_TO_MOVE_INDEX);
+
+    if (moveType == PROMOTION) {
+        placedPiece = getPieceFromPromotionPiece(getPromotionPiece(move), getPieceColor(movedPiece));
+    }
+
+    hash ^= getZobristConstant(ZOBRIST_PIECE_START_INDEX + movedPiece * SQUARES + fromSquare);
+    hash ^= getZobristConstant(ZOBRIST_PIECE_START_INDEX + placedPiece * SQUARES + toSquare);
+
+    if (capturedPiece != EMPTY) {
+        hash ^= getZobristConstant(ZOBRIST_PIECE_START_INDEX + capturedPiece * SQUARES + toSquare);
+    }
+
+    if (moveType == EN_PASSANT) {
+        if (sideToMove == WHITE) {
+            hash ^= getZobristConstant(ZOBRIST_PIECE_START_INDEX + BLACK_PAWN * SQUARES + toSquare + SOUTH);
+        } else {
+            hash ^= getZobristConstant(ZOBRIST_PIECE_START_INDEX + WHITE_PAWN * SQUARES + toSquare + NORTH);
+        }
+    } else if (moveType == CASTLING) {
+        if (toSquare == G1) {
+            hash ^= getZobristConstant(ZOBRIST_PIECE_START_INDEX + WHITE_ROOK * SQUARES + H1);
+            hash ^= getZobristConstant(ZOBRIST_PIECE_START_INDEX + WHITE_ROOK * SQUARES + F1);
+        } else if (toSquare == C1) {
+            hash ^= getZobristConstant(ZOBRIST_PIECE_START_INDEX + WHITE_ROOK * SQUARES + A1);
+            hash ^= getZobristConstant(ZOBRIST_PIECE_START_INDEX + WHITE_ROOK * SQUARES + D1);
+        } else if (toSquare == G8) {
+            hash ^= getZobristConstant(ZOBRIST_PIECE_START_INDEX + BLACK_ROOK * SQUARES + H8);
+            hash ^= getZobristConstant(ZOBRIST_PIECE_START_INDEX + BLACK_ROOK * SQUARES + F8);
+        } else if (toSquare == C8) {
+            hash ^= getZobristConstant(ZOBRIST_PIECE_START_INDEX + BLACK_ROOK * SQUARES + A8);
+            hash ^= getZobristConstant(ZOBRIST_PIECE_START_INDEX + BLACK_ROOK * SQUARES + D8);
+        }
+    }
+
+    // A castling right can only still be set while the king and rook are on their starting squares, so the rights
+    // that are lost only depend on the squares the move touches
+    const uint8_t lostRights = castlingRights & (getCastlingRightsLost(fromSquare) | getCastlingRightsLost(toSquare));
+
+    if (lostRights & WHITE_KINGSIDE) {
+        hash ^= getZobristConstant(ZOBRIST_CASTLING_WHITE_KINGSIDE_INDEX);
+    }
+
+    if (lostRights & WHITE_QUEENSIDE) {
+        hash ^= getZobristConstant(ZOBRIST_CASTLING_WHITE_QUEENSIDE_INDEX);
+    }
+
+    if (lostRights & BLACK_KINGSIDE) {
+        hash ^= getZobristConstant(ZOBRIST_CASTLING_BLACK_KINGSIDE_INDEX);
+    }
+
+    if (lostRights & BLACK_QUEENSIDE) {
+        hash ^= getZobristConstant(ZOBRIST_CASTLING_BLACK_QUEENSIDE_INDEX);
+    }
+
+    if (enPassantSquare != 255) {
+        hash ^= getZobristConstant(ZOBRIST_EN_PASSANT_START_INDEX + (enPassantSquare % 8));
+    }
+
+    if (getPieceType(movedPiece) == PAWN && (fromSquare ^ toSquare) == 16) {
+        hash ^= getZobristConstant(ZOBRIST_EN_PASSANT_START_INDEX + (toSquare % 8));
+    }
+
+    return hash;
+}
+
 /**
  * \brief gets the square of the attacker with the lowest value of a given square
  * \tparam color The color of the attacker.
@@ -415,6 +680,10 @@ void Board::makeMove(const Move move) {
     const PieceType movedPieceType = getPieceType(movedPiece);
     const Piece capturedPiece = getPieceOnSquare(toSquare);
 
+    if (accumulatorStack) {
+        accumulatorStack->push();
+    }
+
     history[ply].move = move;
     history[ply].previousMove = previousMove;
     history[ply].capturedPiece = capturedPiece;
@@ -427,6 +696,7 @@ void Board::makeMove(const Move move) {
     enPassantSquare = 255;
     history[ply].castlingRights = castlingRights;
     history[ply].zobristHash = zobristHash;
+    history[ply].pawnZobristHash = pawnZobristHash;
     history[ply].halfMoveClock = halfMoveClock;
 
     halfMoveClock += 1;
@@ -462,16 +732,15 @@ void Board::makeMove(const Move move) {
         }
     }
 
-    removePiece(movedPiece, fromSquare);
-
     if (moveType == PROMOTION) {
         const PieceColor color = getPieceColor(movedPiece);
         const PromotionPiece promotionPieceType = getPromotionPiece(move);
         const Piece promotionPiece = getPieceFromPromotionPiece(promotionPieceType, color);
 
+        removePiece(movedPiece, fromSquare);
         setPiece(promotionPiece, toSquare);
     } else {
-        setPiece(movedPiece, toSquare);
+        movePiece(movedPiece, fromSquare, toSquare);
     }
 
     if (moveType == EN_PASSANT) {
@@ -482,17 +751,13 @@ void Board::makeMove(const Move move) {
         }
     } else if (moveType == CASTLING) {
         if (toSquare == G1) {
-            removePiece(WHITE_ROOK, H1);
-            setPiece(WHITE_ROOK, F1);
+            movePiece(WHITE_ROOK, H1, F1);
         } else if (toSquare == C1) {
-            removePiece(WHITE_ROOK, A1);
-            setPiece(WHITE_ROOK, D1);
+            movePiece(WHITE_ROOK, A1, D1);
         } else if (toSquare == G8) {
-            removePiece(BLACK_ROOK, H8);
-            setPiece(BLACK_ROOK, F8);
+            movePiece(BLACK_ROOK, H8, F8);
         } else if (toSquare == C8) {
-            removePiece(BLACK_ROOK, A8);
-            setPiece(BLACK_ROOK, D8);
+            movePiece(BLACK_ROOK, A8, D8);
         }
 
         if (sideToMove == WHITE) {
@@ -604,16 +869,21 @@ void Board::unmakeMove() {
     const MoveType moveType = getMoveType(state.move);
     Piece movedPiece = getPieceOnSquare(toSquare);
     const PieceColor movedColor = getPieceColor(movedPiece);
+    // The accumulator below the entry of this move is still valid, so restoring the pieces is not recorded
+    AccumulatorStack* const accumulators = accumulatorStack;
 
-    removePiece(movedPiece, toSquare);
+    accumulatorStack = nullptr;
 
     if (moveType == PROMOTION) {
         const PieceColor color = getPieceColor(movedPiece);
+
+        removePiece(movedPiece, toSquare);
         movedPiece = static_cast<Piece>(WHITE_PAWN + color);
+        setPiece(movedPiece, fromSquare);
+    } else {
+        movePiece(movedPiece, toSquare, fromSquare);
     }
 
-    setPiece(movedPiece, fromSquare);
-
     if (state.capturedPiece != EMPTY) {
         setPiece(state.capturedPiece, toSquare);
     }
@@ -630,17 +900,13 @@ void Board::unmakeMove() {
 
     if (moveType == CASTLING) {
         if (toSquare == G1) {
-            removePiece(WHITE_ROOK, F1);
-            setPiece(WHITE_ROOK, H1);
+            movePiece(WHITE_ROOK, F1, H1);
         } else if (toSquare == C1) {
-            removePiece(WHITE_ROOK, D1);
-            setPiece(WHITE_ROOK, A1);
+            movePiece(WHITE_ROOK, D1, A1);
         } else if (toSquare == G8) {
-            removePiece(BLACK_ROOK, F8);
-            setPiece(BLACK_ROOK, H8);
+            movePiece(BLACK_ROOK, F8, H8);
         } else if (toSquare == C8) {
-            removePiece(BLACK_ROOK, D8);
-            setPiece(BLACK_ROOK, A8);
+            movePiece(BLACK_ROOK, D8, A8);
         }
     }
 
@@ -655,9 +921,25 @@ void Board::unmakeMove() {
     this->enPassantSquare = state.enPassantSquare;
     this->castlingRights = state.castlingRights;
     this->zobristHash = state.zobristHash;
+    this->pawnZobristHash = state.pawnZobristHash;
+
+    // The saved hash excludes the en passant key, so positions that only differ in an uncapturable en passant square
+    // count as repetitions. Put it back to restore the exact hash of the position.
+    if (enPassantSquare != 255) {
+        zobristHash ^= getZobristConstant(ZOBRIST_EN_PASSANT_START_INDEX + (enPassantSquare % 8));
+    }
+    this->accumulatorStack = accumulators;
+
+    if (accumulatorStack) {
+        accumulatorStack->pop();
+    }
 }
 
 void Board::makeNullMove() {
+    if (accumulatorStack) {
+        accumulatorStack->push();
+    }
+
     history[ply].move = NO_MOVE;
     history[ply].previousMove = previousMove;
     history[ply].capturedPiece = EMPTY;
@@ -703,6 +985,14 @@ void Board::unmakeNullMove() {
     this->enPassantSquare = state.enPassantSquare;
     this->castlingRights = state.castlingRights;
     this->zobristHash = state.zobristHash;
+
+    if (enPassantSquare != 255) {
+        zobristHash ^= getZobristConstant(ZOBRIST_EN_PASSANT_START_INDEX + (enPassantSquare % 8));
+    }
+
+    if (accumulatorStack) {
+        accumulatorStack->pop();
+    }
 }
 
 /**
@@ -870,6 +1160,11 @@ bool Board::setFromFEN(const std::string_view fen) {
         }
     }
 
+    // The pieces were placed on the root entry, which does not record changes
+    if (accumulatorStack) {
+        accumulatorStack->reset(*this);
+    }
+
     return true;
 }
 } // namespace Zagreus
@@ -29,6 +29,8 @@
 #include "bitwise.h"
 #include "constants.h"
 #include "move.h"
+#include "nnue.h"
+#include "pst.h"
 #include "types.h"
 
 namespace Zagreus {
@@ -46,7 +48,9 @@ void initZobristConstants();
  * \brief Represents the state of the board at a given ply
  */
 struct BoardState {
+    // The hash of the position before the move, without the en passant key
     uint64_t zobristHash = 0;
+    uint64_t pawnZobristHash = 0;
     Move move = NO_MOVE;
     Move previousMove = NO_MOVE;
     Piece capturedPiece = EMPTY;
@@ -68,13 +72,50 @@ private:
     PieceColor sideToMove = WHITE;
     uint64_t occupied = 0;
     uint64_t zobristHash = 0;
+    uint64_t pawnZobristHash = 0;
+    std::array<Score, COLORS> pstScores{};
+    int phaseMaterial = 0;
     Move previousMove = NO_MOVE;
     uint16_t ply = 0;
     uint16_t fullmoveClock = 1;
     uint8_t halfMoveClock = 0;
     uint8_t castlingRights = 0;
     uint8_t enPassantSquare = 255;
+    AccumulatorStack* accumulatorStack = nullptr;
 
+    /**
+     * \brief Adds the material, PST and phase values of a piece to the running sums of the board and records the
+     * placed piece on the attached accumulator stack.
+     * \param piece The piece that is placed.
+     * \param square The square the piece is placed on.
+     */
+    void addPieceScores(const Piece piece, const uint8_t square) {
+        const PieceColor color = getPieceColor(piece);
+
+        pstScores[color] += pstTable[piece][square];
+        phaseMaterial += PIECE_PHASES[getPieceType(piece)];
+
+        if (accumulatorStack) {
+            accumulatorStack->addChange(piece, square, true);
+        }
+    }
+
+    /**
+     * \brief Removes the material, PST and phase values of a piece from the running sums of the board and records the
+     * removed piece on the attached accumulator stack.
+     * \param piece The piece that is removed.
+     * \param square The square the piece is removed from.
+     */
+    void removePieceScores(const Piece piece, const uint8_t square) {
+        const PieceColor color = getPieceColor(piece);
+
+        pstScores[color] -= pstTable[piece][square];
+        phaseMaterial -= PIECE_PHASES[getPieceType(piece)];
+
+        if (accumulatorStack) {
+            accumulatorStack->addChange(piece, square, false);
+        }
+    }
 public:
     /**
      * \brief Constructs a new Board object and initializes it to the starting position.
@@ -172,9 +213,13 @@ public:
     }
 
     /**
-     * \brief Sets the side to move.
+     * \brief Sets the side to move. Updates the zobrist hash, so hashed data of one side is never used for the other.
      */
     void setSideToMove(const PieceColor color) {
+        if (sideToMove != color) {
+            zobristHash ^= getZobristConstant(ZOBRIST_SIDE_TO_MOVE_INDEX);
+        }
+
         sideToMove = color;
     }
 
@@ -244,6 +289,12 @@ public:
 
         const int zobristIndex = ZOBRIST_PIECE_START_INDEX + static_cast<int>(piece) * SQUARES + square;
         zobristHash ^= getZobristConstant(zobristIndex);
+
+        if (getPieceType(piece) == PAWN) {
+            pawnZobristHash ^= getZobristConstant(zobristIndex);
+        }
+
+        addPieceScores(piece, square);
     }
 
     /**
@@ -263,6 +314,12 @@ public:
 
         const int zobristIndex = ZOBRIST_PIECE_START_INDEX + static_cast<int>(piece) * SQUARES + square;
         zobristHash ^= getZobristConstant(zobristIndex);
+
+        if (getPieceType(piece) == PAWN) {
+            pawnZobristHash ^= getZobristConstant(zobristIndex);
+        }
+
+        addPieceScores(piece, square);
     }
 
     /**
@@ -281,6 +338,12 @@ public:
 
         const int zobristIndex = ZOBRIST_PIECE_START_INDEX + static_cast<int>(piece) * SQUARES + square;
         zobristHash ^= getZobristConstant(zobristIndex);
+
+        if (getPieceType(piece) == PAWN) {
+            pawnZobristHash ^= getZobristConstant(zobristIndex);
+        }
+
+        removePieceScores(piece, square);
     }
 
     /**
@@ -301,6 +364,12 @@ public:
 
         const int zobristIndex = ZOBRIST_PIECE_START_INDEX + static_cast<int>(piece) * SQUARES + square;
         zobristHash ^= getZobristConstant(zobristIndex);
+
+        if (getPieceType(piece) == PAWN) {
+            pawnZobristHash ^= getZobristConstant(zobristIndex);
+        }
+
+        removePieceScores(piece, square);
     }
 
     /**
@@ -320,6 +389,49 @@ public:
 
         const int zobristIndex = ZOBRIST_PIECE_START_INDEX + static_cast<int>(piece) * SQUARES + square;
         zobristHash ^= getZobristConstant(zobristIndex);
+
+        if (getPieceType(piece) == PAWN) {
+            pawnZobristHash ^= getZobristConstant(zobristIndex);
+        }
+
+        removePieceScores(piece, square);
+    }
+
+    /**
+     * \brief Moves a piece to an empty square. Does the work of removePiece and setPiece in one step: the phase
+     * material stays the same and the PST sum only changes by the difference between the two squares.
+     * \param piece The piece to move.
+     * \param fromSquare The square index the piece is on (0-63).
+     * \param toSquare The index of the empty square to move the piece to (0-63).
+     */
+    void movePiece(const Piece piece, const uint8_t fromSquare, const uint8_t toSquare) {
+        assert(piece != Piece::EMPTY);
+        assert(board[fromSquare] == piece);
+        assert(board[toSquare] == Piece::EMPTY);
+        const uint64_t fromToBB = squareToBitboard(fromSquare) | squareToBitboard(toSquare);
+        const PieceColor color = getPieceColor(piece);
+
+        board[fromSquare] = EMPTY;
+        board[toSquare] = piece;
+        bitboards[piece] ^= fromToBB;
+        occupied ^= fromToBB;
+        colorBoards[color] ^= fromToBB;
+
+        const int zobristIndex = ZOBRIST_PIECE_START_INDEX + static_cast<int>(piece) * SQUARES;
+        const uint64_t zobristKey = getZobristConstant(zobristIndex + fromSquare)
+                                    ^ getZobristConstant(zobristIndex + toSquare);
+        zobristHash ^= zobristKey;
+
+        if (getPieceType(piece) == PAWN) {
+            pawnZobristHash ^= zobristKey;
+        }
+
+        pstScores[color] += pstTable[piece][toSquare] - pstTable[piece][fromSquare];
+
+        if (accumulatorStack) {
+            accumulatorStack->addChange(piece, fromSquare, false);
+            accumulatorStack->addChange(piece, toSquare, true);
+        }
     }
 
     /**
@@ -374,6 +486,14 @@ public:
      */
     [[nodiscard]] uint64_t getSquareAttackers(Square square) const;
 
+    /**
+     * \brief Retrieves the attackers of a given square, with sliding attacks computed for the given occupancy.
+     * \param square The square index (0-63).
+     * \param occupancy The occupancy bitboard that blocks sliding pieces.
+     * \return A bitboard representing the attackers.
+     */
+    [[nodiscard]] uint64_t getSquareAttackers(Square square, uint64_t occupancy) const;
+
     /**
      * \brief Retrieves the attackers of a given square by color.
      * \tparam color The color of the attackers.
@@ -405,6 +525,12 @@ public:
      */
     void reset();
 
+    /**
+     * \brief Copies the complete state of another board, including its history, into this board.
+     * \param other The board to copy from.
+     */
+    void copyFrom(const Board& other);
+
     /**
      * \brief Prints the current state of the board to the console.
      */
@@ -417,6 +543,14 @@ public:
      */
     bool isDraw() const;
 
+    /**
+     * \brief Checks if the side to move has a move that repeats a position of the current search line. Uses cuckoo
+     * tables of all reversible moves, so a repetition is found one ply before it is on the board.
+     * \param searchPly The amount of plies since the root of the search. Only repetitions after the root are found.
+     * \return True if a move of the side to move leads to a position that occurred after the root, false otherwise.
+     */
+    [[nodiscard]] bool hasUpcomingRepetition(int searchPly) const;
+
     /**
      * \brief Gets the current zobrist hash of the board. It is pre-computed and will only be retrieved from memory.
      *
@@ -424,6 +558,56 @@ public:
      */
     uint64_t getZobristHash() const;
 
+    /**
+     * \brief Gets the zobrist hash of only the pawns on the board. It is updated incrementally, just like the full hash.
+     *
+     * \return The current pawn zobrist hash of the board.
+     */
+    [[nodiscard]] uint64_t getPawnZobristHash() const {
+        return pawnZobristHash;
+    }
+
+    /**
+     * \brief Gets the packed sum of the material and PST values of all pieces of a color. It is updated incrementally.
+     * \param color The color to get the score of.
+     * \return The packed midgame and endgame material and PST score of the color.
+     */
+    [[nodiscard]] Score getPstScore(const PieceColor color) const {
+        return pstScores[color];
+    }
+
+    /**
+     * \brief Gets the sum of the phase values of all pieces on the board. It is updated incrementally.
+     * \return The phase material of the board, TOTAL_PHASE in the starting position.
+     */
+    [[nodiscard]] int getPhaseMaterial() const {
+        return phaseMaterial;
+    }
+
+    /**
+     * \brief Attaches an accumulator stack that follows the moves made on the board, or detaches it. The stack is not
+     * copied by copyFrom. Resets the stack to the current position.
+     * \param stack The accumulator stack, or nullptr to detach the current one.
+     */
+    void setAccumulatorStack(AccumulatorStack* stack);
+
+    /**
+     * \brief Gets the attached accumulator stack.
+     * \return The accumulator stack, or nullptr if none is attached.
+     */
+    [[nodiscard]] AccumulatorStack* getAccumulatorStack() const {
+        return accumulatorStack;
+    }
+
+    /**
+     * \brief Computes the zobrist hash the board would have after making the given move, without making it. Used to
+     * prefetch the transposition table entry of the child position before the move is made.
+     * \param move The move, which must be pseudo-legal in the current position.
+     *
+     * \return The zobrist hash after the move.
+     */
+    [[nodiscard]] uint64_t getZobristHashAfterMove(Move move) const;
+
     /**
      * \brief gets the square of the attacker with the lowest value of a given square
      * \tparam color The color of the attacker.
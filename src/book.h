@@ -0,0 +1,121 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "move.h"
+
+namespace Zagreus {
+class Board;
+
+/**
+ * \brief An entry of a Polyglot book file. The file stores the fields big-endian and sorted by key.
+ */
+struct PolyglotEntry {
+    uint64_t key = 0;
+    uint16_t move = 0;
+    uint16_t weight = 0;
+    uint32_t learn = 0;
+};
+
+constexpr size_t POLYGLOT_ENTRY_SIZE = 16;
+
+/**
+ * \brief A move of the book with its weight.
+ */
+struct BookMove {
+    Move move = NO_MOVE;
+    uint16_t weight = 0;
+};
+
+/**
+ * \brief Calculates the Polyglot key of a position. Polyglot books use their own fixed zobrist constants, so this key
+ * is different from the zobrist hash of the board.
+ */
+uint64_t getPolyglotKey(const Board& board);
+
+/**
+ * \brief An opening book in the Polyglot format. The file is memory mapped and the entries of a position are found
+ * with a binary search, so a lookup costs a few page reads at most.
+ */
+class OpeningBook {
+private:
+    const uint8_t* entries = nullptr;
+    uint64_t entryCount = 0;
+    void* mappedFile = nullptr;
+    uint64_t mappedFileSize = 0;
+    // Only used when the file can't be memory mapped
+    std::vector<uint8_t> fileData{};
+    std::mt19937 random{std::random_device{}()};
+
+    [[nodiscard]] PolyglotEntry getEntry(uint64_t index) const;
+
+public:
+    OpeningBook() = default;
+
+    ~OpeningBook();
+
+    OpeningBook(const OpeningBook&) = delete;
+
+    OpeningBook& operator=(const OpeningBook&) = delete;
+
+    /**
+     * \brief Opens a Polyglot book file. Closes the book that was open before.
+     * \param path The path of the file.
+     * \return True if the book was opened, false otherwise.
+     */
+    bool open(const std::string& path);
+
+    /**
+     * \brief Closes the book.
+     */
+    void close();
+
+    [[nodiscard]] bool isOpen() const {
+        return entries != nullptr;
+    }
+
+    [[nodiscard]] uint64_t getEntryCount() const {
+        return entryCount;
+    }
+
+    /**
+     * \brief Gets the legal book moves of a position.
+     * \param board The board. Moves are made and unmade on it to check if they are legal.
+     * \return The moves in the order of the book, with the moves that are not legal left out.
+     */
+    [[nodiscard]] std::vector<BookMove> getMoves(Board& board) const;
+
+    /**
+     * \brief Picks a book move for a position, with a chance that is proportional to the weight of the move.
+     * \param board The board.
+     * \param move Set to the picked move.
+     * \return True if the position is in the book, false otherwise.
+     */
+    bool probe(Board& board, Move& move);
+
+    static OpeningBook* getOpeningBook();
+};
+} // namespace Zagreus
@@ -66,6 +66,7 @@
 #define NO_MOVE 0
 
 #define NO_TT_SCORE INT16_MIN
+#define NO_EVAL_SCORE INT16_MIN
 
 #define MAX_HISTORY 16384
 
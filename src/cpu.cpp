@@ -0,0 +1,53 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cpu.h"
+
+namespace Zagreus {
+InstructionSet detectInstructionSet() {
+#ifdef ZAGREUS_X86_DISPATCH
+    __builtin_cpu_init();
+
+    // Also checks that the operating system saves the AVX registers
+    if (__builtin_cpu_supports("avx2")) {
+        return AVX2;
+    }
+
+    if (__builtin_cpu_supports("sse2")) {
+        return SSE2;
+    }
+#endif
+
+    return SCALAR;
+}
+
+std::string_view getInstructionSetName(const InstructionSet instructionSet) {
+    switch (instructionSet) {
+        case AVX2:
+            return "AVX2";
+        case SSE2:
+            return "SSE2";
+        case SCALAR:
+            return "scalar";
+    }
+
+    return "unknown";
+}
+} // namespace Zagreus
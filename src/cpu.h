@@ -0,0 +1,53 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+// Kernels for every instruction set are compiled into the binary with target attributes, whatever -march is used
+#define ZAGREUS_X86_DISPATCH
+#define ZAGREUS_TARGET_SSE2 __attribute__((target("sse2")))
+#define ZAGREUS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace Zagreus {
+/**
+ * \brief The instruction sets there are kernels for, ordered from the least to the most capable.
+ */
+enum InstructionSet : uint8_t {
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+/**
+ * \brief Detects the most capable instruction set the CPU and the operating system support, using CPUID.
+ * \return The best supported instruction set, SCALAR if the kernels are not available for this platform.
+ */
+[[nodiscard]] InstructionSet detectInstructionSet();
+
+/**
+ * \brief Gets the name of an instruction set, as printed on startup.
+ */
+[[nodiscard]] std::string_view getInstructionSetName(InstructionSet instructionSet);
+} // namespace Zagreus
@@ -29,20 +29,13 @@
 
 namespace Zagreus {
 /**
- * \brief Adds the given midgame and endgame score to the given color.
+ * \brief Adds the given packed midgame and endgame score to the given color.
  * \tparam color The color to add the score to.
- * \param midgameScore The midgame score to add.
- * \param endgameScore The endgame score to add.
+ * \param score The packed score to add.
  */
 template <PieceColor color>
-void Evaluation::addScore(const int midgameScore, const int endgameScore) {
-    if (color == WHITE) {
-        whiteMidgameScore += midgameScore;
-        whiteEndgameScore += endgameScore;
-    } else {
-        blackMidgameScore += midgameScore;
-        blackEndgameScore += endgameScore;
-    }
+void Evaluation::addScore(const Score score) {
+    scores[color] += score;
 }
 
 /**
@@ -56,24 +49,62 @@ void Evaluation::addScore(const int midgameScore, const int endgameScore) {
  */
 int Evaluation::evaluate() {
     const int phase = calculatePhase();
-    const int modifier = board.getSideToMove() == WHITE ? 1 : -1;
+
+    // The board keeps the material and PST sums up to date while making moves
+    addScore<WHITE>(board.getPstScore(WHITE));
+    addScore<BLACK>(board.getPstScore(BLACK));
 
     initializeEvalData();
+    evaluatePieces();
+
+    return getTaperedScore(phase);
+}
+
+/**
+ * \brief Evaluates the current board position in stages. The material and PST score is known in O(1), so it is
+ * computed first. Only if it is close enough to the window to be changed into a different result by the other terms,
+ * the attack maps and all terms that depend on them are computed as well.
+ *
+ * \param alpha The lower bound of the window, from the perspective of the side to move.
+ * \param beta The upper bound of the window, from the perspective of the side to move.
+ * \param isExact Set to true if the full evaluation was computed, false if only the material and PST score was.
+ * \return The evaluation score of the current board position.
+ */
+int Evaluation::evaluate(const int alpha, const int beta, bool& isExact) {
+    const int phase = calculatePhase();
+
+    addScore<WHITE>(board.getPstScore(WHITE));
+    addScore<BLACK>(board.getPstScore(BLACK));
+
+    const int lazyScore = getTaperedScore(phase);
 
+    if (lazyScore - LAZY_EVAL_MARGIN >= beta || lazyScore + LAZY_EVAL_MARGIN <= alpha) {
+        isExact = false;
+        return lazyScore;
+    }
+
+    isExact = true;
+    initializeEvalData();
     evaluatePieces();
 
-    const int whiteScore = ((whiteMidgameScore * (256 - phase)) + (whiteEndgameScore * phase)) / 256;
-    const int blackScore = ((blackMidgameScore * (256 - phase)) + (blackEndgameScore * phase)) / 256;
+    return getTaperedScore(phase);
+}
+
+/**
+ * \brief Tapers the scores collected so far between the midgame and endgame.
+ * \param phase The phase of the game, as returned by calculatePhase.
+ * \return The tapered score from the perspective of the side to move.
+ */
+int Evaluation::getTaperedScore(const int phase) const {
+    const int modifier = board.getSideToMove() == WHITE ? 1 : -1;
+    const int whiteScore = ((getMidgameScore(scores[WHITE]) * (256 - phase)) + (getEndgameScore(scores[WHITE]) * phase))
+                           / 256;
+    const int blackScore = ((getMidgameScore(scores[BLACK]) * (256 - phase)) + (getEndgameScore(scores[BLACK]) * phase))
+                           / 256;
 
     return (whiteScore - blackScore) * modifier;
 }
 
-constexpr int knightPhase = 1;
-constexpr int bishopPhase = 1;
-constexpr int rookPhase = 2;
-constexpr int queenPhase = 4;
-constexpr int totalPhase = knightPhase * 4 + bishopPhase * 4 + rookPhase * 4 + queenPhase * 2;
-
 /**
  * \brief Calculates the phase of the game.
  *
@@ -84,19 +115,13 @@ constexpr int totalPhase = knightPhase * 4 + bishopPhase * 4 + rookPhase * 4 + q
  * \return The phase of the game as an integer.
  */
 int Evaluation::calculatePhase() const {
-    int phase = totalPhase;
+    const int phase = TOTAL_PHASE - board.getPhaseMaterial();
 
-    phase -= popcnt(board.getPieceBoard<WHITE_KNIGHT>() | board.getPieceBoard<BLACK_KNIGHT>()) * knightPhase;
-    phase -= popcnt(board.getPieceBoard<WHITE_BISHOP>() | board.getPieceBoard<BLACK_BISHOP>()) * bishopPhase;
-    phase -= popcnt(board.getPieceBoard<WHITE_ROOK>() | board.getPieceBoard<BLACK_ROOK>()) * rookPhase;
-    phase -= popcnt(board.getPieceBoard<WHITE_QUEEN>() | board.getPieceBoard<BLACK_QUEEN>()) * queenPhase;
-
-    return (phase * 256 + (totalPhase / 2)) / totalPhase;
+    return (phase * 256 + (TOTAL_PHASE / 2)) / TOTAL_PHASE;
 }
 
 void Evaluation::evaluatePieces() {
-    evaluatePawns<WHITE>();
-    evaluatePawns<BLACK>();
+    evaluatePawnStructure();
 
     // Exclude enemy pawn attacks from mobility after evaluatePawns filled the attack tables
     evalData.mobilityArea[WHITE] &= ~evalData.attacksByPiece[BLACK_PAWN];
@@ -121,30 +146,60 @@ void Evaluation::evaluatePieces() {
     evaluateSquareControl<BLACK>();
 }
 
+void Evaluation::evaluatePawnStructure() {
+    PawnHashEntry localEntry{};
+    PawnHashEntry* entry = &localEntry;
+
+    if (pawnTable) {
+        const uint64_t pawnZobristHash = board.getPawnZobristHash();
+
+        entry = &pawnTable->getEntry(pawnZobristHash);
+
+        if (entry->key != pawnZobristHash) {
+            *entry = PawnHashEntry{};
+            evaluatePawns<WHITE>(*entry);
+            evaluatePawns<BLACK>(*entry);
+            entry->key = pawnZobristHash;
+        }
+    } else {
+        evaluatePawns<WHITE>(localEntry);
+        evaluatePawns<BLACK>(localEntry);
+    }
+
+    // The pawns are evaluated first, so the attack tables only contain pawn attacks at this point
+    for (const PieceColor color : {WHITE, BLACK}) {
+        const Piece pawnPiece = color == WHITE ? WHITE_PAWN : BLACK_PAWN;
+
+        evalData.attacksByColor[color] = entry->attacks[color];
+        evalData.attacksByPiece[pawnPiece] = entry->attacks[color];
+        evalData.attackedBy2[color] = entry->attackedBy2[color];
+        evalData.pawnAttackSpans[color] = entry->attackSpans[color];
+    }
+}
+
 template <PieceColor color>
-void Evaluation::evaluatePawns() {
+void Evaluation::evaluatePawns(PawnHashEntry& entry) {
     constexpr Piece pawnPiece = color == WHITE ? WHITE_PAWN : BLACK_PAWN;
-    uint64_t pawns = board.getPieceBoard<pawnPiece>();
+    const uint64_t pawnBoard = board.getPieceBoard<pawnPiece>();
+    uint64_t pawns = pawnBoard;
 
     while (pawns) {
         const Square square = static_cast<Square>(popLsb(pawns));
-        const int midgamePst = midgamePstTable[pawnPiece][square];
-        const int endgamePst = endgamePstTable[pawnPiece][square];
 
 #ifdef ZAGREUS_TUNER
         trace.material[color][PAWN] += 1;
         trace.pst[color][PAWN][square] += 1;
 #endif
 
-        addScore<color>(midgamePst, endgamePst);
-
         const uint64_t attacks = getPawnAttacks<color>(square);
 
-        evalData.attacksFrom[square] = attacks;
-        evalData.attackedBy2[color] |= (attacks & evalData.attacksByColor[color]);
-        evalData.attacksByColor[color] |= attacks;
-        evalData.attacksByPiece[pawnPiece] |= attacks;
+        entry.attackedBy2[color] |= (attacks & entry.attacks[color]);
+        entry.attacks[color] |= attacks;
     }
+
+    entry.attackSpans[color] = color == WHITE
+                                   ? calculateWhitePawnAttackSpan(pawnBoard)
+                                   : calculateBlackPawnAttackSpan(pawnBoard);
 }
 
 /**
@@ -157,16 +212,12 @@ void Evaluation::evaluateKnights() {
 
     while (knights) {
         const Square square = static_cast<Square>(popLsb(knights));
-        const int midgamePst = midgamePstTable[knightPiece][square];
-        const int endgamePst = endgamePstTable[knightPiece][square];
 
 #ifdef ZAGREUS_TUNER
         trace.material[color][KNIGHT] += 1;
         trace.pst[color][KNIGHT][square] += 1;
 #endif
 
-        addScore<color>(midgamePst, endgamePst);
-
         const uint64_t attacks = getKnightAttacks(square);
 
         evalData.attacksFrom[square] = attacks;
@@ -176,14 +227,12 @@ void Evaluation::evaluateKnights() {
 
         const uint64_t mobility = attacks & evalData.mobilityArea[color];
         const int mobilityScore = popcnt(mobility);
-        const int midgameMobilityScore = evalMobility[MIDGAME][KNIGHT] * mobilityScore;
-        const int endgameMobilityScore = evalMobility[ENDGAME][KNIGHT] * mobilityScore;
 
 #ifdef ZAGREUS_TUNER
         trace.mobility[color][KNIGHT] += mobilityScore;
 #endif
 
-        addScore<color>(midgameMobilityScore, endgameMobilityScore);
+        addScore<color>(evalMobility[KNIGHT] * mobilityScore);
     }
 }
 
@@ -194,16 +243,12 @@ void Evaluation::evaluateBishops() {
 
     while (bishops) {
         const Square square = static_cast<Square>(popLsb(bishops));
-        const int midgamePst = midgamePstTable[bishopPiece][square];
-        const int endgamePst = endgamePstTable[bishopPiece][square];
 
 #ifdef ZAGREUS_TUNER
         trace.material[color][BISHOP] += 1;
         trace.pst[color][BISHOP][square] += 1;
 #endif
 
-        addScore<color>(midgamePst, endgamePst);
-
         const uint64_t attacks = getBishopAttacks(square, board.getOccupiedBitboard());
 
         evalData.attacksFrom[square] = attacks;
@@ -213,14 +258,12 @@ void Evaluation::evaluateBishops() {
 
         const uint64_t mobility = attacks & evalData.mobilityArea[color];
         const int mobilityScore = popcnt(mobility);
-        const int midgameMobilityScore = evalMobility[MIDGAME][BISHOP] * mobilityScore;
-        const int endgameMobilityScore = evalMobility[ENDGAME][BISHOP] * mobilityScore;
 
 #ifdef ZAGREUS_TUNER
         trace.mobility[color][BISHOP] += mobilityScore;
 #endif
 
-        addScore<color>(midgameMobilityScore, endgameMobilityScore);
+        addScore<color>(evalMobility[BISHOP] * mobilityScore);
     }
 }
 
@@ -231,16 +274,12 @@ void Evaluation::evaluateRooks() {
 
     while (rooks) {
         const Square square = static_cast<Square>(popLsb(rooks));
-        const int midgamePst = midgamePstTable[rookPiece][square];
-        const int endgamePst = endgamePstTable[rookPiece][square];
 
 #ifdef ZAGREUS_TUNER
         trace.material[color][ROOK] += 1;
         trace.pst[color][ROOK][square] += 1;
 #endif
 
-        addScore<color>(midgamePst, endgamePst);
-
         const uint64_t attacks = getRookAttacks(square, board.getOccupiedBitboard());
 
         evalData.attacksFrom[square] = attacks;
@@ -250,14 +289,12 @@ void Evaluation::evaluateRooks() {
 
         const uint64_t mobility = attacks & evalData.mobilityArea[color];
         const int mobilityScore = popcnt(mobility);
-        const int midgameMobilityScore = evalMobility[MIDGAME][ROOK] * mobilityScore;
-        const int endgameMobilityScore = evalMobility[ENDGAME][ROOK] * mobilityScore;
 
 #ifdef ZAGREUS_TUNER
         trace.mobility[color][ROOK] += mobilityScore;
 #endif
 
-        addScore<color>(midgameMobilityScore, endgameMobilityScore);
+        addScore<color>(evalMobility[ROOK] * mobilityScore);
     }
 }
 
@@ -268,16 +305,12 @@ void Evaluation::evaluateQueens() {
 
     while (queens) {
         const Square square = static_cast<Square>(popLsb(queens));
-        const int midgamePst = midgamePstTable[queenPiece][square];
-        const int endgamePst = endgamePstTable[queenPiece][square];
 
 #ifdef ZAGREUS_TUNER
         trace.material[color][QUEEN] += 1;
         trace.pst[color][QUEEN][square] += 1;
 #endif
 
-        addScore<color>(midgamePst, endgamePst);
-
         const uint64_t attacks = queenAttacks(square, board.getOccupiedBitboard());
 
         evalData.attacksFrom[square] = attacks;
@@ -287,14 +320,12 @@ void Evaluation::evaluateQueens() {
 
         const uint64_t mobility = attacks & evalData.mobilityArea[color];
         const int mobilityScore = popcnt(mobility);
-        const int midgameMobilityScore = evalMobility[MIDGAME][QUEEN] * mobilityScore;
-        const int endgameMobilityScore = evalMobility[ENDGAME][QUEEN] * mobilityScore;
 
 #ifdef ZAGREUS_TUNER
         trace.mobility[color][QUEEN] += mobilityScore;
 #endif
 
-        addScore<color>(midgameMobilityScore, endgameMobilityScore);
+        addScore<color>(evalMobility[QUEEN] * mobilityScore);
     }
 }
 
@@ -303,16 +334,11 @@ void Evaluation::evaluateKing() {
     constexpr Piece kingPiece = color == WHITE ? WHITE_KING : BLACK_KING;
     const Square square = board.getKingSquare<color>();
 
-    const int midgamePst = midgamePstTable[kingPiece][square];
-    const int endgamePst = endgamePstTable[kingPiece][square];
-
 #ifdef ZAGREUS_TUNER
     trace.material[color][KING] += 1;
     trace.pst[color][KING][square] += 1;
 #endif
 
-    addScore<color>(midgamePst, endgamePst);
-
     const uint64_t attacks = getKingAttacks(square);
 
     evalData.attacksFrom[square] = attacks;
@@ -355,18 +381,14 @@ void Evaluation::evaluateSquareControl() {
     int piecesOnWeakSquaresCount = popcnt(piecesOnWeakSquares);
     int unoccupiedStrongSquaresCount = popcnt(unoccupiedStrongSquares);
 
-    int midgameScore = 0;
-    int endgameScore = 0;
+    Score score = 0;
 
     // TODO: Add tracing
-    midgameScore += piecesOnStrongSquaresCount * evalPieceOnStrongSquare[MIDGAME];
-    endgameScore += piecesOnStrongSquaresCount * evalPieceOnStrongSquare[ENDGAME];
-    midgameScore += piecesOnWeakSquaresCount * evalPieceOnWeakSquare[MIDGAME];
-    endgameScore += piecesOnWeakSquaresCount * evalPieceOnWeakSquare[ENDGAME];
-    midgameScore += unoccupiedStrongSquaresCount * evalUnoccupiedStrongSquare[MIDGAME];
-    endgameScore += unoccupiedStrongSquaresCount * evalUnoccupiedStrongSquare[ENDGAME];
-
-    addScore<color>(midgameScore, endgameScore);
+    score += piecesOnStrongSquaresCount * evalPieceOnStrongSquare;
+    score += piecesOnWeakSquaresCount * evalPieceOnWeakSquare;
+    score += unoccupiedStrongSquaresCount * evalUnoccupiedStrongSquare;
+
+    addScore<color>(score);
 }
 
 /**
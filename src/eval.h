@@ -24,17 +24,21 @@
 #include "board.h"
 #include "constants.h"
 #include "eval_features.h"
+#include "pawn_hash.h"
+#include "score.h"
 
 namespace Zagreus {
 
 struct EvalData {
     uint64_t mobilityArea[COLORS];
 
-    // These are initialized later by evaluatePieces
+    // These are initialized later by evaluatePieces. attacksFrom is not filled for pawns, their attacks are only stored
+    // per color in attacksByPiece.
     uint64_t attacksFrom[SQUARES];
     uint64_t attacksByColor[COLORS];
     uint64_t attacksByPiece[PIECES];
     uint64_t attackedBy2[COLORS];
+    uint64_t pawnAttackSpans[COLORS];
 };
 
 #ifdef ZAGREUS_TUNER
@@ -45,23 +49,30 @@ struct EvalTrace {
 };
 #endif
 
+// The terms that depend on the attack maps are assumed to never change the evaluation by more than this
+constexpr int LAZY_EVAL_MARGIN = 300;
+
 class Evaluation {
 private:
     const Board& board;
+    PawnHashTable* pawnTable;
     EvalData evalData{};
-    int whiteMidgameScore{};
-    int whiteEndgameScore{};
-    int blackMidgameScore{};
-    int blackEndgameScore{};
+    Score scores[COLORS]{};
 
     /**
-     * \brief Adds the given midgame and endgame score to the given color.
+     * \brief Adds the given packed midgame and endgame score to the given color.
      * \tparam color The color to add the score to.
-     * \param midgameScore The midgame score to add.
-     * \param endgameScore The endgame score to add.
+     * \param score The packed score to add.
      */
     template <PieceColor color>
-    void addScore(int midgameScore, int endgameScore);
+    void addScore(Score score);
+
+    /**
+     * \brief Tapers the scores collected so far between the midgame and endgame.
+     * \param phase The phase of the game.
+     * \return The tapered score from the perspective of the side to move.
+     */
+    [[nodiscard]] int getTaperedScore(int phase) const;
 
     /**
      * \brief Evaluates several features related to pieces on the board.
@@ -69,11 +80,18 @@ private:
     void evaluatePieces();
 
     /**
-    * \brief Evaluates features related to pawns on the board.
+     * \brief Fills the pawn attack maps of the eval data, using the pawn hash table if there is one.
+     */
+    void evaluatePawnStructure();
+
+    /**
+    * \brief Computes the attack maps of the pawns on the board. Only depends on the pawns, so the result is stored in a
+    * pawn hash entry.
     * \tparam color The color of the pawn to evaluate.
+    * \param entry The entry to store the attacks of the pawns of the given color in.
     */
     template <PieceColor color>
-    void evaluatePawns();
+    void evaluatePawns(PawnHashEntry& entry);
 
     /**
      * \brief Evaluates features related to knights on the board.
@@ -125,8 +143,9 @@ public:
     /**
      * \brief Constructs an Evaluation object with the given board.
      * \param board The current state of the chess board.
+     * \param pawnTable The pawn hash table of the search thread, or nullptr to always evaluate the pawns.
      */
-    explicit Evaluation(const Board& board) : board(board) {}
+    explicit Evaluation(const Board& board, PawnHashTable* pawnTable = nullptr) : board(board), pawnTable(pawnTable) {}
 
     Evaluation(const Evaluation&) = delete;
 
@@ -144,6 +163,16 @@ public:
      */
     [[nodiscard]] int evaluate();
 
+    /**
+     * \brief Evaluates the current board position, but skips the expensive terms if the material and PST score alone
+     * is more than LAZY_EVAL_MARGIN outside the window.
+     * \param alpha The lower bound of the window, from the perspective of the side to move.
+     * \param beta The upper bound of the window, from the perspective of the side to move.
+     * \param isExact Set to true if the full evaluation was computed.
+     * \return The evaluation score of the current board position.
+     */
+    [[nodiscard]] int evaluate(int alpha, int beta, bool& isExact);
+
     /**
      * \brief Evaluates the material on the board.
      *
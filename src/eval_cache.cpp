@@ -0,0 +1,44 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "eval_cache.h"
+#include <algorithm>
+#include <bit>
+
+namespace Zagreus {
+void EvalCache::resize(const int megaBytes) {
+    entries.clear();
+    entries.shrink_to_fit();
+    indexMask = 0;
+
+    if (megaBytes <= 0) {
+        return;
+    }
+
+    const uint64_t entryCount = std::bit_floor(static_cast<uint64_t>(megaBytes) * 1024 * 1024 / sizeof(uint64_t));
+
+    entries.resize(entryCount, 0);
+    indexMask = entryCount - 1;
+}
+
+void EvalCache::clear() {
+    std::fill(entries.begin(), entries.end(), 0);
+}
+} // namespace Zagreus
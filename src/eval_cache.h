@@ -0,0 +1,88 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Zagreus {
+/**
+ * \brief A small direct-mapped cache of static evaluations, owned by a single search thread so it needs no
+ * synchronization. Every entry packs the upper 48 bits of the zobrist hash and the 16-bit evaluation into one word. A
+ * new evaluation always replaces the old one at its index.
+ */
+class EvalCache {
+private:
+    std::vector<uint64_t> entries{};
+    uint64_t indexMask = 0;
+
+public:
+    /**
+     * \brief Resizes the cache to the largest power of two amount of entries that fits in the given size. Clears the
+     * cache.
+     * \param megaBytes The size of the cache in megabytes. 0 disables the cache.
+     */
+    void resize(int megaBytes);
+
+    /**
+     * \brief Removes all entries from the cache.
+     */
+    void clear();
+
+    /**
+     * \brief Looks up the static evaluation of a position.
+     * \param zobristHash The zobrist hash of the position.
+     * \param eval Set to the cached evaluation if the position was found.
+     * \return True if the position was found, false otherwise.
+     */
+    [[nodiscard]] bool probe(uint64_t zobristHash, int& eval) const {
+        if (entries.empty()) {
+            return false;
+        }
+
+        const uint64_t entry = entries[zobristHash & indexMask];
+
+        if (entry == 0 || ((entry ^ zobristHash) & ~0xFFFFULL) != 0) {
+            return false;
+        }
+
+        eval = static_cast<int16_t>(entry & 0xFFFF);
+        return true;
+    }
+
+    /**
+     * \brief Stores the static evaluation of a position, replacing whatever was stored at its index.
+     * \param zobristHash The zobrist hash of the position.
+     * \param eval The static evaluation, which has to fit in 16 bits.
+     */
+    void store(const uint64_t zobristHash, const int eval) {
+        if (entries.empty()) {
+            return;
+        }
+
+        entries[zobristHash & indexMask] = (zobristHash & ~0xFFFFULL) | static_cast<uint16_t>(eval);
+    }
+
+    [[nodiscard]] bool isEnabled() const {
+        return !entries.empty();
+    }
+};
+} // namespace Zagreus
@@ -24,20 +24,19 @@
 
 namespace Zagreus {
 // Base material values
-int evalMaterialValues[GAME_PHASES][PIECE_TYPES] = {
-    {100, 350, 350, 525, 1000, 0}, // Midgame
-    {100, 350, 350, 525, 1000, 0}  // Endgame
+Score evalMaterialValues[PIECE_TYPES] = {
+    makeScore(100, 100), makeScore(350, 350), makeScore(350, 350), makeScore(525, 525), makeScore(1000, 1000),
+    makeScore(0, 0)
 };
 
 // Base mobility values
-int evalMobility[GAME_PHASES][PIECE_TYPES] = {
-    {0, 4, 6, 2, 4, 0}, // Midgame
-    {0, 2, 3, 5, 6, 0}  // Endgame
+Score evalMobility[PIECE_TYPES] = {
+    makeScore(0, 0), makeScore(4, 2), makeScore(6, 3), makeScore(2, 5), makeScore(4, 6), makeScore(0, 0)
 };
 
-int evalPieceOnStrongSquare[GAME_PHASES]{4, 1};
+Score evalPieceOnStrongSquare = makeScore(4, 1);
 
-int evalPieceOnWeakSquare[GAME_PHASES]{-4, -1};
+Score evalPieceOnWeakSquare = makeScore(-4, -1);
 
-int evalUnoccupiedStrongSquare[GAME_PHASES]{2, 0};
+Score evalUnoccupiedStrongSquare = makeScore(2, 0);
 } // namespace Zagreus
@@ -23,15 +23,16 @@
 
 #include "constants.h"
 #include "pst.h"
+#include "score.h"
 
 namespace Zagreus {
-extern int evalMaterialValues[GAME_PHASES][PIECE_TYPES];
+extern Score evalMaterialValues[PIECE_TYPES];
 
-extern int evalMobility[GAME_PHASES][PIECE_TYPES];
+extern Score evalMobility[PIECE_TYPES];
 
-extern int evalPieceOnStrongSquare[GAME_PHASES];
+extern Score evalPieceOnStrongSquare;
 
-extern int evalPieceOnWeakSquare[GAME_PHASES];
+extern Score evalPieceOnWeakSquare;
 
-extern int evalUnoccupiedStrongSquare[GAME_PHASES];
+extern Score evalUnoccupiedStrongSquare;
 } // namespace Zagreus
@@ -18,16 +18,28 @@
  along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <cstdint>
+#include <charconv>
 #include <chrono>
 #include <exception>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <ratio>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <vector>
 
+#include "analysis_db.h"
 #include "board.h"
+#include "perft.h"
 #include "search.h"
+#include "thread_pool.h"
 #include "tt.h"
 #include "tuner.h"
 #include "types.h"
@@ -103,16 +115,68 @@ const std::vector<std::string> FAST_BENCHMARK_POSITIONS = {
     "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124"
 };
 
-void benchmark(bool fast);
+// FEN string, depth, expected nodes
+const std::vector<std::tuple<std::string, int, uint64_t>> PERFT_BENCHMARK_POSITIONS = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6, 119060324},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 193690690},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 5, 89941194},
+    {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594},
+};
+
+// Same as the maximum of the Threads option
+constexpr int MAX_THREAD_COUNT = 1024;
+
+bool parseNumber(const std::string& arg, int& value);
+
+void benchmark(bool fast, int threadCount);
+
+int benchmarkPerft(int threadCount);
+
+int runAnalysisDatabaseCommand(const std::vector<std::string>& args);
+
+int runPerftSuite(const std::vector<std::string>& args);
 
 int main(const int argc, char* argv[]) {
     if (argc > 1) {
         if (std::string(argv[1]) == "bench") {
-            const bool fast = argc > 2 && std::string(argv[2]) == "fast";
-            benchmark(fast);
+            // Usage: bench [fast] [threads] | bench perft [threads]
+            if (argc > 2 && std::string(argv[2]) == "perft") {
+                int threadCount = 1;
+
+                if (argc > 3) {
+                    parseNumber(argv[3], threadCount);
+                }
+
+                return benchmarkPerft(std::clamp(threadCount, 1, MAX_THREAD_COUNT));
+            }
+
+            bool fast = false;
+            int threadCount = 1;
+
+            for (int i = 2; i < argc; i++) {
+                const std::string arg = argv[i];
+
+                if (arg == "fast") {
+                    fast = true;
+                } else {
+                    parseNumber(arg, threadCount);
+                }
+            }
+
+            benchmark(fast, std::clamp(threadCount, 1, MAX_THREAD_COUNT));
             return 0;
         }
 
+        if (std::string(argv[1]) == "analysisdb") {
+            return runAnalysisDatabaseCommand(std::vector<std::string>(argv + 2, argv + argc));
+        }
+
+        if (std::string(argv[1]) == "perftsuite") {
+            return runPerftSuite(std::vector<std::string>(argv + 2, argv + argc));
+        }
+
 #ifdef ZAGREUS_TUNER
         if (std::string(argv[1]) == "tune") {
             const std::string filePath = argc > 2 ? std::string(argv[2]) : "";
@@ -140,15 +204,187 @@ int main(const int argc, char* argv[]) {
     return 0;
 }
 
-void benchmark(bool fast) {
+/**
+ * \brief Parses a command line argument that has to be a non-negative integer.
+ * \param arg The argument to parse.
+ * \param value Set to the parsed value, or INT32_MAX if it does not fit. Left unchanged if the argument is not a
+ * number.
+ * \return True if the argument is a number.
+ */
+bool parseNumber(const std::string& arg, int& value) {
+    if (arg.empty() || !std::ranges::all_of(arg, ::isdigit)) {
+        return false;
+    }
+
+    if (std::from_chars(arg.data(), arg.data() + arg.size(), value).ec == std::errc::result_out_of_range) {
+        value = INT32_MAX;
+    }
+
+    return true;
+}
+
+int runAnalysisDatabaseCommand(const std::vector<std::string>& args) {
+    // Usage: analysisdb compact <file> | analysisdb merge <output> <input>...
+    const bool isCompact = args.size() == 2 && args[0] == "compact";
+    const bool isMerge = args.size() >= 3 && args[0] == "merge";
+
+    if (!isCompact && !isMerge) {
+        std::cerr << "Usage: analysisdb compact <file> | analysisdb merge <output> <input>..." << std::endl;
+        return 1;
+    }
+
+    const std::string outputPath = args[1];
+    const std::vector<std::string> inputPaths = isCompact
+                                                    ? std::vector<std::string>{outputPath}
+                                                    : std::vector<std::string>(args.begin() + 2, args.end());
+
+    if (!AnalysisDatabase::merge(outputPath, inputPaths)) {
+        std::cerr << "Could not " << args[0] << " the analysis databases" << std::endl;
+        return 1;
+    }
+
+    AnalysisDatabase output{};
+
+    if (!output.open(outputPath)) {
+        std::cerr << "Could not open " << outputPath << std::endl;
+        return 1;
+    }
+
+    std::cout << "Wrote " << output.getRecordCount() << " positions to " << outputPath << std::endl;
+    return 0;
+}
+
+int runPerftSuite(const std::vector<std::string>& args) {
+    // Usage: perftsuite <file.epd> [threads] [max depth]
+    int threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    int maxDepth = INT32_MAX;
+
+    if (args.empty() || args.size() > 3 || (args.size() > 1 && !parseNumber(args[1], threadCount)) ||
+        (args.size() > 2 && !parseNumber(args[2], maxDepth))) {
+        std::cerr << "Usage: perftsuite <file.epd> [threads] [max depth]" << std::endl;
+        return 1;
+    }
+
+    threadCount = std::clamp(threadCount, 1, MAX_THREAD_COUNT);
+    std::ifstream file(args[0]);
+
+    if (!file) {
+        std::cerr << "Could not open " << args[0] << std::endl;
+        return 1;
+    }
+
+    std::vector<PerftSuiteEntry> entries{};
+    std::string line;
+    int lineNumber = 0;
+
+    while (std::getline(file, line)) {
+        PerftSuiteEntry entry{};
+        lineNumber += 1;
+
+        if (line.find_first_not_of(" \t\r") == std::string::npos || line[0] == '#') {
+            continue;
+        }
+
+        if (!parsePerftSuiteLine(line, entry)) {
+            std::cerr << "Invalid perft suite line " << lineNumber << ": " << line << std::endl;
+            return 1;
+        }
+
+        std::erase_if(entry.depths, [maxDepth](const auto& depth) { return depth.first > maxDepth; });
+        entries.push_back(std::move(entry));
+    }
+
+    Engine engine{};
+
+    engine.registerOptions();
+    engine.doSetup();
+
+    // Positions are divided over the threads, each position is counted by a single thread on its own board
+    std::atomic<size_t> nextEntry{0};
+    std::atomic<int> failedPositions{0};
+    std::atomic<uint64_t> totalNodes{0};
+    std::mutex outputMutex{};
+    std::vector<std::thread> threads{};
+    const auto suiteStart = std::chrono::steady_clock::now();
+
+    for (int threadId = 0; threadId < std::min<int>(threadCount, static_cast<int>(entries.size())); threadId++) {
+        threads.emplace_back([&] {
+            const auto board = std::make_unique<Board>();
+
+            for (size_t index = nextEntry++; index < entries.size(); index = nextEntry++) {
+                const PerftSuiteEntry& entry = entries[index];
+                std::string errors{};
+                uint64_t nodes = 0;
+                const auto start = std::chrono::steady_clock::now();
+
+                if (!board->setFromFEN(entry.fen)) {
+                    errors += " invalid FEN";
+                }
+
+                for (const auto& [depth, expectedNodes] : entry.depths) {
+                    if (!errors.empty()) {
+                        break;
+                    }
+
+                    const uint64_t depthNodes = perft(*board, depth, false);
+
+                    nodes += depthNodes;
+
+                    if (depthNodes != expectedNodes) {
+                        errors += " D" + std::to_string(depth) + " expected " + std::to_string(expectedNodes) +
+                            " got " + std::to_string(depthNodes);
+                    }
+                }
+
+                const auto end = std::chrono::steady_clock::now();
+                const double seconds = std::chrono::duration<double>(end - start).count();
+                const auto nodesPerSecond = static_cast<uint64_t>(seconds == 0
+                                                                      ? 0
+                                                                      : static_cast<double>(nodes) / seconds);
+
+                totalNodes += nodes;
+                failedPositions += errors.empty() ? 0 : 1;
+
+                std::scoped_lock lock(outputMutex);
+                std::cout << "Position " << index + 1 << "/" << entries.size() << (errors.empty() ? " PASS" : " FAIL")
+                          << errors << ", " << nodes << " nodes " << std::to_string(seconds) << "s " << nodesPerSecond
+                          << " nps (" << entry.fen << ")" << std::endl;
+            }
+        });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - suiteStart).count();
+    const uint64_t nodes = totalNodes;
+    const auto nodesPerSecond = static_cast<uint64_t>(seconds == 0 ? 0 : static_cast<double>(nodes) / seconds);
+
+    const size_t passedPositions = entries.size() - static_cast<size_t>(failedPositions.load());
+
+    std::cout << "Passed " << passedPositions << "/" << entries.size() << " positions with " << threadCount
+              << " threads" << std::endl;
+    std::cout << "Time: " << std::to_string(seconds) << "s" << std::endl;
+    std::cout << nodes << " nodes " << nodesPerSecond << " nps" << std::endl;
+    return failedPositions == 0 ? 0 : 1;
+}
+
+void benchmark(bool fast, const int threadCount) {
     Engine engine{};
     uint64_t nodes = 0;
+    uint64_t ttProbes = 0;
+    uint64_t ttHits = 0;
+    uint64_t cacheHits = 0;
+    uint64_t cacheMisses = 0;
+    uint64_t lazyEvals = 0;
     double totalMs = 0;
     Board board{};
 
     engine.registerOptions();
     engine.doSetup();
-    TranspositionTable::getTT()->setTableSize(128);
+    engine.setThreadCount(threadCount);
+    TranspositionTable::getTT()->setTableSize(128, threadCount);
     std::vector<std::string> positions = fast ? FAST_BENCHMARK_POSITIONS : BENCHMARK_POSITIONS;
     SearchParams params{};
 
@@ -156,24 +392,32 @@ void benchmark(bool fast) {
 
     for (const std::string& position : positions) {
         for (int i = 0; i < 2; i++) {
-            TranspositionTable::getTT()->reset();
+            TranspositionTable::getTT()->reset(threadCount);
             const PieceColor color = i == 0 ? WHITE : BLACK;
 
             board.setFromFEN(position);
             board.setSideToMove(color);
-            SearchStats stats{};
             auto start = std::chrono::steady_clock::now();
 
-            if (color == WHITE) {
-                search<WHITE>(engine, board, params, stats);
-            } else {
-                search<BLACK>(engine, board, params, stats);
-            }
+            engine.getThreadPool().startSearch(board, params, false);
+            engine.getThreadPool().waitForSearchFinished();
 
             auto end = std::chrono::steady_clock::now();
             std::chrono::duration<double, std::milli> elapsed = end - start;
 
-            nodes += stats.nodesSearched + stats.qNodesSearched;
+            uint64_t positionTTProbes = 0;
+            uint64_t positionTTHits = 0;
+            uint64_t positionCacheHits = 0;
+            uint64_t positionCacheMisses = 0;
+
+            engine.getThreadPool().getTTStatistics(positionTTProbes, positionTTHits);
+            engine.getThreadPool().getEvalCacheStatistics(positionCacheHits, positionCacheMisses);
+            nodes += engine.getNodesSearched();
+            ttProbes += positionTTProbes;
+            ttHits += positionTTHits;
+            cacheHits += positionCacheHits;
+            cacheMisses += positionCacheMisses;
+            lazyEvals += engine.getThreadPool().getLazyEvals();
             totalMs += elapsed.count();
         }
     }
@@ -185,7 +429,70 @@ void benchmark(bool fast) {
 
     const double secondsSpent = totalMs / 1000.0;
     const uint64_t nodesPerSecond = static_cast<uint64_t>(static_cast<double>(nodes) / secondsSpent);
+
+    // Time to depth, used to measure the speedup of multiple threads
+    engine.sendMessage("Threads: " + std::to_string(threadCount) + ", time to depth " + std::to_string(params.depth) +
+                       ": " + std::to_string(static_cast<uint64_t>(totalMs)) + " ms");
+
+    const double ttHitRate = ttProbes == 0 ? 0.0 : 100.0 * static_cast<double>(ttHits) / static_cast<double>(ttProbes);
+
+    engine.sendMessage("TT hit rate: " + std::to_string(ttHitRate) + "% (" + std::to_string(ttHits) + "/" +
+                       std::to_string(ttProbes) + " probes)");
+
+    const uint64_t cacheLookups = cacheHits + cacheMisses;
+    const double cacheHitRate = cacheLookups == 0
+                                    ? 0.0
+                                    : 100.0 * static_cast<double>(cacheHits) / static_cast<double>(cacheLookups);
+
+    engine.sendMessage("Eval cache hit rate: " + std::to_string(cacheHitRate) + "% (" + std::to_string(cacheHits) +
+                       "/" + std::to_string(cacheLookups) + " lookups)");
+    engine.sendMessage("Lazy evaluations: " + std::to_string(lazyEvals));
+
     std::string message = std::to_string(nodes) + " nodes " + std::to_string(nodesPerSecond) + " nps";
 
     engine.sendMessage(message);
 }
+
+int benchmarkPerft(const int threadCount) {
+    Engine engine{};
+    uint64_t totalNodes = 0;
+    double totalSeconds = 0;
+    bool allPassed = true;
+    Board board{};
+
+    engine.registerOptions();
+    engine.doSetup();
+
+    for (const auto& [fen, depth, expectedNodes] : PERFT_BENCHMARK_POSITIONS) {
+        if (!board.setFromFEN(fen)) {
+            engine.sendMessage("ERROR: Invalid FEN " + fen);
+            allPassed = false;
+            continue;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t nodes = perft(board, depth, false, threadCount);
+        const auto end = std::chrono::steady_clock::now();
+        const double seconds = std::chrono::duration<double>(end - start).count();
+        const uint64_t nodesPerSecond = seconds == 0 ? 0 : static_cast<uint64_t>(static_cast<double>(nodes) / seconds);
+
+        if (nodes != expectedNodes) {
+            engine.sendMessage("ERROR: Expected " + std::to_string(expectedNodes) + " nodes at depth " +
+                               std::to_string(depth) + " for " + fen + ", got " + std::to_string(nodes));
+            allPassed = false;
+        }
+
+        engine.sendMessage("Depth " + std::to_string(depth) + ": " + std::to_string(nodes) + " nodes " +
+                           std::to_string(seconds) + "s " + std::to_string(nodesPerSecond) + " nps (" + fen + ")");
+        totalNodes += nodes;
+        totalSeconds += seconds;
+    }
+
+    const uint64_t nodesPerSecond = totalSeconds == 0
+                                        ? 0
+                                        : static_cast<uint64_t>(static_cast<double>(totalNodes) / totalSeconds);
+
+    engine.sendMessage("Threads: " + std::to_string(threadCount) + ", time: " + std::to_string(totalSeconds) + "s");
+    engine.sendMessage(std::to_string(totalNodes) + " nodes " + std::to_string(nodesPerSecond) + " nps");
+    return allPassed ? 0 : 1;
+}
@@ -32,7 +32,11 @@
 namespace Zagreus {
 
 /**
- * \brief Generates all pseudo-legal moves for all pieces of a certain color for a given color and generation type.
+ * \brief Generates all legal moves for all pieces of a certain color for a given color and generation type.
+ *
+ * Legality is resolved during generation: the checkers of the king restrict the target squares of all non-king
+ * moves, pinned pieces may only move along their pin ray and king moves and castling are only generated to squares
+ * that are not attacked. Moves returned by this function never leave the own king in check.
  * \tparam color The color of the pieces to generate moves for.
  * \tparam type The type of moves to generate (e.g., all moves, captures, quiet moves).
  * \param board The board object for which to generate moves.
@@ -43,73 +47,121 @@ void generateMoves(const Board& board, MoveList& moves) {
     assert(moves.size == 0);
 
     constexpr Piece ownKing = color == WHITE ? WHITE_KING : BLACK_KING;
+    constexpr Piece ownPawn = color == WHITE ? WHITE_PAWN : BLACK_PAWN;
     constexpr Piece opponentKing = color == WHITE ? BLACK_KING : WHITE_KING;
     constexpr PieceColor opponentColor = !color;
-    bool onlyKingMoves = false;
     const uint64_t ownPieces = board.getColorBitboard<color>();
+    const uint64_t opponentPieces = board.getColorBitboard<opponentColor>();
     const uint64_t opponentKingBB = board.getPieceBoard<opponentKing>();
+    const Square kingSquare = bitboardToSquare(board.getPieceBoard<ownKing>());
+    const uint64_t checkers = board.getSquareAttackersByColor<opponentColor>(kingSquare);
     uint64_t genMask = ~(ownPieces | opponentKingBB);
 
     if (type == QSEARCH) {
-        const uint64_t opponentPieces = board.getColorBitboard<opponentColor>();
-
         genMask &= opponentPieces;
-    } else if (type == EVASIONS) {
-        const Square kingSquare = bitboardToSquare(board.getPieceBoard<ownKing>());
-        const uint64_t attackers = board.getSquareAttackersByColor<opponentColor>(kingSquare);
+    }
 
-        if (popcnt(attackers) == 1) {
-            const Square attackerSquare = bitboardToSquare(attackers);
-            const PieceType attackerType = getPieceType(board.getPieceOnSquare(attackerSquare));
-            uint64_t evasionsMask = attackers;
+    // When in check the king may always move to any safe square, even when only captures are generated otherwise
+    const uint64_t kingGenMask = type == QSEARCH && !checkers ? genMask : ~(ownPieces | opponentKingBB);
 
-            if (isSlidingPiece(attackerType)) {
-                const uint64_t squaresBetween = getSquaresBetween(attackerSquare, kingSquare);
+    if (popcnt(checkers) > 1) {
+        // If the king is in double check, only king moves are legal
+        generateKingMoves<color, type>(board, moves, kingGenMask, true);
+        return;
+    }
 
-                evasionsMask |= squaresBetween;
-            }
+    if (checkers) {
+        const Square attackerSquare = bitboardToSquare(checkers);
+        const PieceType attackerType = getPieceType(board.getPieceOnSquare(attackerSquare));
+        uint64_t evasionsMask = checkers;
 
-            genMask = evasionsMask;
-        } else {
-            // If the king is in double check, only king moves are legal
-            onlyKingMoves = true;
+        if (isSlidingPiece(attackerType)) {
+            const uint64_t squaresBetween = getSquaresBetween(attackerSquare, kingSquare);
+
+            evasionsMask |= squaresBetween;
         }
+
+        genMask = type == QSEARCH ? genMask & evasionsMask : evasionsMask;
     }
 
-    if (!onlyKingMoves) {
-        generatePawnMoves<color, type>(board, moves, genMask);
-        generateKnightMoves<color, type>(board, moves, genMask);
-        generateBishopMoves<color, type>(board, moves, genMask);
-        generateRookMoves<color, type>(board, moves, genMask);
-        generateQueenMoves<color, type>(board, moves, genMask);
+    const PinMasks pins = getPinMasks<color>(board, kingSquare);
+    const uint64_t pawnBB = board.getPieceBoard<ownPawn>();
+    uint64_t pinnedPawns = pawnBB & pins.pinned;
+
+    generatePawnMoves<color, type>(board, moves, genMask, pawnBB & ~pins.pinned);
+
+    while (pinnedPawns) {
+        const uint8_t fromSquare = popLsb(pinnedPawns);
+
+        generatePawnMoves<color, type>(board, moves, genMask & pins.rays[fromSquare], squareToBitboard(fromSquare));
     }
 
-    if (type == EVASIONS) {
-        // We generate all king moves when in check, so we don't use genMask
-        generateKingMoves<color, type>(board, moves, ~(ownPieces | opponentKingBB));
-    } else {
-        generateKingMoves<color, type>(board, moves, genMask);
+    if (type != QSEARCH) {
+        generateEnPassantMoves<color>(board, moves, kingSquare);
     }
 
-    assert(type == QSEARCH || genMask != 0);
+    generateKnightMoves<color, type>(board, moves, genMask, pins);
+    generateBishopMoves<color, type>(board, moves, genMask, pins);
+    generateRookMoves<color, type>(board, moves, genMask, pins);
+    generateQueenMoves<color, type>(board, moves, genMask, pins);
+    generateKingMoves<color, type>(board, moves, kingGenMask, checkers != 0);
+
     assert((genMask & ownPieces) == 0);
     assert((genMask & opponentKingBB) == 0);
 }
 
 /**
- * \brief Generates all pseudo-legal pawn moves for a given color and generation type.
+ * \brief Finds the pieces of the given color that are pinned to their own king.
+ * \tparam color The color of the king and the pinned pieces.
+ * \param board The board object to find the pins in.
+ * \param kingSquare The square of the king of the given color.
+ * \return The pinned pieces and, for each of them, the squares they can move to without exposing the king.
+ */
+template <PieceColor color>
+PinMasks getPinMasks(const Board& board, const Square kingSquare) {
+    constexpr PieceColor opponentColor = !color;
+    constexpr Piece opponentBishop = color == WHITE ? BLACK_BISHOP : WHITE_BISHOP;
+    constexpr Piece opponentRook = color == WHITE ? BLACK_ROOK : WHITE_ROOK;
+    constexpr Piece opponentQueen = color == WHITE ? BLACK_QUEEN : WHITE_QUEEN;
+
+    const uint64_t occupied = board.getOccupiedBitboard();
+    const uint64_t ownPieces = board.getColorBitboard<color>();
+    const uint64_t opponentPieces = board.getColorBitboard<opponentColor>();
+    const uint64_t opponentQueens = board.getPieceBoard<opponentQueen>();
+    const uint64_t diagonalSliders = board.getPieceBoard<opponentBishop>() | opponentQueens;
+    const uint64_t straightSliders = board.getPieceBoard<opponentRook>() | opponentQueens;
+    // Sliders that would attack the king if only the opponent pieces were on the board
+    uint64_t snipers = (getBishopAttacks(kingSquare, opponentPieces) & diagonalSliders)
+                       | (getRookAttacks(kingSquare, opponentPieces) & straightSliders);
+    PinMasks pins;
+
+    while (snipers) {
+        const uint8_t sniperSquare = popLsb(snipers);
+        const uint64_t squaresBetween = getSquaresBetween(static_cast<Square>(sniperSquare), kingSquare);
+        const uint64_t blockers = squaresBetween & occupied;
+
+        if (blockers && !(blockers & (blockers - 1)) && (blockers & ownPieces)) {
+            pins.pinned |= blockers;
+            pins.rays[bitboardToSquare(blockers)] = squaresBetween | squareToBitboard(sniperSquare);
+        }
+    }
+
+    return pins;
+}
+
+/**
+ * \brief Generates all legal pawn moves for a given color and generation type, except for en passant captures.
  * \tparam color The color of the pawns to generate moves for.
  * \tparam type The type of moves to generate (e.g., all moves, captures, quiet moves).
  * \param board The board object for which to generate moves.
  * \param[out] moves The list to store the generated moves.
  * \param genMask The mask to filter out invalid moves.
+ * \param pawnBB The pawns to generate moves for.
  */
 template <PieceColor color, GenerationType type>
-void generatePawnMoves(const Board& board, MoveList& moves, const uint64_t genMask) {
-    constexpr Piece pawn = color == WHITE ? WHITE_PAWN : BLACK_PAWN;
+void generatePawnMoves(const Board& board, MoveList& moves, const uint64_t genMask, const uint64_t pawnBB) {
     constexpr PieceColor opponentColor = !color;
 
-    const uint64_t pawnBB = board.getPieceBoard<pawn>();
     const uint64_t emptyBB = board.getEmptyBitboard();
     const uint64_t opponentPieces = board.getColorBitboard<opponentColor>();
     uint64_t pawnSinglePushes;
@@ -129,18 +181,10 @@ void generatePawnMoves(const Board& board, MoveList& moves, const uint64_t genMa
         pawnEastAttacks = blackPawnEastAttacks(pawnBB);
     }
 
-    uint64_t enPassantMask = squareToBitboard(board.getEnPassantSquare());
-
-    if constexpr (color == WHITE) {
-        enPassantMask &= RANK_6;
-    } else {
-        enPassantMask &= RANK_3;
-    }
-
     pawnSinglePushes &= genMask;
     pawnDoublePushes &= genMask;
-    pawnWestAttacks &= (opponentPieces | enPassantMask) & genMask;
-    pawnEastAttacks &= (opponentPieces | enPassantMask) & genMask;
+    pawnWestAttacks &= opponentPieces & genMask;
+    pawnEastAttacks &= opponentPieces & genMask;
 
     constexpr Direction fromPushDirection = color == WHITE ? NORTH : SOUTH;
     constexpr Direction fromSqWestAttackDirection = color == WHITE ? NORTH_WEST : SOUTH_WEST;
@@ -181,23 +225,17 @@ void generatePawnMoves(const Board& board, MoveList& moves, const uint64_t genMa
         const uint64_t squareToBB = squareToBitboard(squareTo);
         const uint8_t squareFrom = squareTo - fromSqWestAttackDirection;
 
-        if (squareTo == board.getEnPassantSquare() && squareToBB & enPassantMask) {
-            const Move move = encodeMove(squareFrom, squareTo, EN_PASSANT);
-            moves.moves[moves.size] = move;
-            moves.size++;
-        } else {
-            if (squareToBB & promotionRank) {
-                for (const PromotionPiece promotionPiece : {QUEEN_PROMOTION, ROOK_PROMOTION, BISHOP_PROMOTION,
-                                                            KNIGHT_PROMOTION}) {
-                    const Move move = encodeMove(squareFrom, squareTo, promotionPiece);
-                    moves.moves[moves.size] = move;
-                    moves.size++;
-                }
-            } else {
-                const Move move = encodeMove(squareFrom, squareTo);
+        if (squareToBB & promotionRank) {
+            for (const PromotionPiece promotionPiece : {QUEEN_PROMOTION, ROOK_PROMOTION, BISHOP_PROMOTION,
+                                                        KNIGHT_PROMOTION}) {
+                const Move move = encodeMove(squareFrom, squareTo, promotionPiece);
                 moves.moves[moves.size] = move;
                 moves.size++;
             }
+        } else {
+            const Move move = encodeMove(squareFrom, squareTo);
+            moves.moves[moves.size] = move;
+            moves.size++;
         }
     }
 
@@ -206,39 +244,77 @@ void generatePawnMoves(const Board& board, MoveList& moves, const uint64_t genMa
         const uint64_t squareToBB = squareToBitboard(squareTo);
         const uint8_t squareFrom = squareTo - fromSqEastAttackDirection;
 
-        if (squareTo == board.getEnPassantSquare() && squareToBB & enPassantMask) {
-            const Move move = encodeMove(squareFrom, squareTo, EN_PASSANT);
-            moves.moves[moves.size] = move;
-            moves.size++;
-        } else {
-            if (squareToBB & promotionRank) {
-                for (const PromotionPiece promotionPiece : {QUEEN_PROMOTION, ROOK_PROMOTION, BISHOP_PROMOTION,
-                                                            KNIGHT_PROMOTION}) {
-                    const Move move = encodeMove(squareFrom, squareTo, promotionPiece);
-                    moves.moves[moves.size] = move;
-                    moves.size++;
-                }
-            } else {
-                const Move move = encodeMove(squareFrom, squareTo);
+        if (squareToBB & promotionRank) {
+            for (const PromotionPiece promotionPiece : {QUEEN_PROMOTION, ROOK_PROMOTION, BISHOP_PROMOTION,
+                                                        KNIGHT_PROMOTION}) {
+                const Move move = encodeMove(squareFrom, squareTo, promotionPiece);
                 moves.moves[moves.size] = move;
                 moves.size++;
             }
+        } else {
+            const Move move = encodeMove(squareFrom, squareTo);
+            moves.moves[moves.size] = move;
+            moves.size++;
+        }
+    }
+}
+
+/**
+ * \brief Generates all legal en passant captures for a given color.
+ *
+ * En passant removes two pieces from the same rank, which can expose the king in ways a pin mask does not capture,
+ * so every candidate is verified by recomputing the attackers of the king with the occupancy after the capture.
+ * \tparam color The color of the pawns to generate moves for.
+ * \param board The board object for which to generate moves.
+ * \param[out] moves The list to store the generated moves.
+ * \param kingSquare The square of the king of the given color.
+ */
+template <PieceColor color>
+void generateEnPassantMoves(const Board& board, MoveList& moves, const Square kingSquare) {
+    constexpr Piece pawn = color == WHITE ? WHITE_PAWN : BLACK_PAWN;
+    constexpr PieceColor opponentColor = !color;
+    constexpr uint64_t enPassantRank = color == WHITE ? RANK_6 : RANK_3;
+    const uint8_t enPassantSquare = board.getEnPassantSquare();
+
+    if (enPassantSquare >= SQUARES || !(squareToBitboard(enPassantSquare) & enPassantRank)) {
+        return;
+    }
+
+    const uint64_t enPassantBB = squareToBitboard(enPassantSquare);
+    const uint64_t capturedBB = color == WHITE ? shiftSouth(enPassantBB) : shiftNorth(enPassantBB);
+    const uint64_t opponentPieces = board.getColorBitboard<opponentColor>() & ~capturedBB;
+    uint64_t attackers = getPawnAttacks<opponentColor>(enPassantSquare) & board.getPieceBoard<pawn>();
+
+    while (attackers) {
+        const uint8_t fromSquare = popLsb(attackers);
+        const uint64_t occupiedAfter = (board.getOccupiedBitboard() ^ squareToBitboard(fromSquare) ^ capturedBB)
+                                       | enPassantBB;
+
+        if (board.getSquareAttackers(kingSquare, occupiedAfter) & opponentPieces) {
+            continue;
         }
+
+        const Move move = encodeMove(fromSquare, enPassantSquare, EN_PASSANT);
+
+        moves.moves[moves.size] = move;
+        moves.size++;
     }
 }
 
 /**
- * \brief Generates all pseudo-legal knight moves for a given color and generation type.
+ * \brief Generates all legal knight moves for a given color and generation type.
  * \tparam color The color of the knights to generate moves for.
  * \tparam type The type of moves to generate (e.g., all moves, captures, quiet moves).
  * \param board The board object for which to generate moves.
  * \param[out] moves The list to store the generated moves.
  * \param genMask The mask to filter out invalid moves.
+ * \param pins The pinned pieces of the given color.
  */
 template <PieceColor color, GenerationType type>
-void generateKnightMoves(const Board& board, MoveList& moves, const uint64_t genMask) {
+void generateKnightMoves(const Board& board, MoveList& moves, const uint64_t genMask, const PinMasks& pins) {
     constexpr Piece knight = color == WHITE ? WHITE_KNIGHT : BLACK_KNIGHT;
-    uint64_t knightBB = board.getPieceBoard<knight>();
+    // A pinned knight can never move along its pin ray
+    uint64_t knightBB = board.getPieceBoard<knight>() & ~pins.pinned;
 
     while (knightBB) {
         const uint8_t fromSquare = popLsb(knightBB);
@@ -256,15 +332,16 @@ void generateKnightMoves(const Board& board, MoveList& moves, const uint64_t gen
 }
 
 /**
- * \brief Generates all pseudo-legal bishop moves for a given color and generation type.
+ * \brief Generates all legal bishop moves for a given color and generation type.
  * \tparam color The color of the bishops to generate moves for.
  * \tparam type The type of moves to generate (e.g., all moves, captures, quiet moves).
  * \param board The board object for which to generate moves.
  * \param[out] moves The list to store the generated moves.
  * \param genMask The mask to filter out invalid moves.
+ * \param pins The pinned pieces of the given color.
  */
 template <PieceColor color, GenerationType type>
-void generateBishopMoves(const Board& board, MoveList& moves, const uint64_t genMask) {
+void generateBishopMoves(const Board& board, MoveList& moves, const uint64_t genMask, const PinMasks& pins) {
     constexpr Piece bishop = color == WHITE ? WHITE_BISHOP : BLACK_BISHOP;
     const uint64_t occupied = board.getOccupiedBitboard();
     uint64_t bishopBB = board.getPieceBoard<bishop>();
@@ -273,6 +350,10 @@ void generateBishopMoves(const Board& board, MoveList& moves, const uint64_t gen
         const uint8_t fromSquare = popLsb(bishopBB);
         uint64_t genBB = getBishopAttacks(fromSquare, occupied) & genMask;
 
+        if (pins.pinned & squareToBitboard(fromSquare)) {
+            genBB &= pins.rays[fromSquare];
+        }
+
         while (genBB) {
             const uint8_t toSquare = popLsb(genBB);
             const Move move = encodeMove(fromSquare, toSquare);
@@ -284,15 +365,16 @@ void generateBishopMoves(const Board& board, MoveList& moves, const uint64_t gen
 }
 
 /**
- * \brief Generates all pseudo-legal rook moves for a given color and generation type.
+ * \brief Generates all legal rook moves for a given color and generation type.
  * \tparam color The color of the rooks to generate moves for.
  * \tparam type The type of moves to generate (e.g., all moves, captures, quiet moves).
  * \param board The board object for which to generate moves.
  * \param[out] moves The list to store the generated moves.
  * \param genMask The mask to filter out invalid moves.
+ * \param pins The pinned pieces of the given color.
  */
 template <PieceColor color, GenerationType type>
-void generateRookMoves(const Board& board, MoveList& moves, const uint64_t genMask) {
+void generateRookMoves(const Board& board, MoveList& moves, const uint64_t genMask, const PinMasks& pins) {
     constexpr Piece rook = color == WHITE ? WHITE_ROOK : BLACK_ROOK;
     const uint64_t occupied = board.getOccupiedBitboard();
     uint64_t rookBB = board.getPieceBoard<rook>();
@@ -301,6 +383,10 @@ void generateRookMoves(const Board& board, MoveList& moves, const uint64_t genMa
         const uint8_t fromSquare = popLsb(rookBB);
         uint64_t genBB = getRookAttacks(fromSquare, occupied) & genMask;
 
+        if (pins.pinned & squareToBitboard(fromSquare)) {
+            genBB &= pins.rays[fromSquare];
+        }
+
         while (genBB) {
             const uint8_t toSquare = popLsb(genBB);
             const Move move = encodeMove(fromSquare, toSquare);
@@ -312,15 +398,16 @@ void generateRookMoves(const Board& board, MoveList& moves, const uint64_t genMa
 }
 
 /**
- * \brief Generates all pseudo-legal queen moves for a given color and generation type.
+ * \brief Generates all legal queen moves for a given color and generation type.
  * \tparam color The color of the queens to generate moves for.
  * \tparam type The type of moves to generate (e.g., all moves, captures, quiet moves).
  * \param board The board object for which to generate moves.
  * \param[out] moves The list to store the generated moves.
  * \param genMask The mask to filter out invalid moves.
+ * \param pins The pinned pieces of the given color.
  */
 template <PieceColor color, GenerationType type>
-void generateQueenMoves(const Board& board, MoveList& moves, const uint64_t genMask) {
+void generateQueenMoves(const Board& board, MoveList& moves, const uint64_t genMask, const PinMasks& pins) {
     constexpr Piece queen = color == WHITE ? WHITE_QUEEN : BLACK_QUEEN;
     const uint64_t occupied = board.getOccupiedBitboard();
     uint64_t queenBB = board.getPieceBoard<queen>();
@@ -329,6 +416,10 @@ void generateQueenMoves(const Board& board, MoveList& moves, const uint64_t genM
         const uint8_t fromSquare = popLsb(queenBB);
         uint64_t genBB = queenAttacks(fromSquare, occupied) & genMask;
 
+        if (pins.pinned & squareToBitboard(fromSquare)) {
+            genBB &= pins.rays[fromSquare];
+        }
+
         while (genBB) {
             const uint8_t toSquare = popLsb(genBB);
             const Move move = encodeMove(fromSquare, toSquare);
@@ -340,53 +431,94 @@ void generateQueenMoves(const Board& board, MoveList& moves, const uint64_t genM
 }
 
 /**
- * \brief Generates all pseudo-legal king moves for a given color and generation type.
+ * \brief Checks whether none of the squares on a castling path are attacked by the opponent.
+ * \tparam color The color of the castling king.
+ * \param board The board object to check.
+ * \param castlingPath The squares the king passes over and lands on.
+ * \return True if the king can pass over the path safely, false otherwise.
+ */
+template <PieceColor color>
+static bool isCastlingPathSafe(const Board& board, uint64_t castlingPath) {
+    constexpr PieceColor opponentColor = !color;
+
+    while (castlingPath) {
+        const Square square = static_cast<Square>(popLsb(castlingPath));
+
+        if (board.getSquareAttackersByColor<opponentColor>(square)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * \brief Generates all legal king moves for a given color and generation type.
  * \tparam color The color of the king to generate moves for.
  * \tparam type The type of moves to generate (e.g., all moves, captures, quiet moves).
  * \param board The board object for which to generate moves.
  * \param[out] moves The list to store the generated moves.
  * \param genMask The mask to filter out invalid moves.
+ * \param isInCheck Whether the king is currently in check.
  */
 template <PieceColor color, GenerationType type>
-void generateKingMoves(const Board& board, MoveList& moves, const uint64_t genMask) {
+void generateKingMoves(const Board& board, MoveList& moves, const uint64_t genMask, const bool isInCheck) {
     constexpr Piece king = color == WHITE ? WHITE_KING : BLACK_KING;
-    uint64_t kingBB = board.getPieceBoard<king>();
-    const uint8_t fromSquare = popLsb(kingBB);
+    constexpr PieceColor opponentColor = !color;
+    const uint64_t kingBB = board.getPieceBoard<king>();
+    const uint64_t opponentPieces = board.getColorBitboard<opponentColor>();
+    // The king must not be able to hide behind itself from a slider that is checking it
+    const uint64_t occupiedWithoutKing = board.getOccupiedBitboard() ^ kingBB;
+    const uint8_t fromSquare = bitboardToSquare(kingBB);
     uint64_t genBB = getKingAttacks(fromSquare) & genMask;
 
     while (genBB) {
         const uint8_t toSquare = popLsb(genBB);
+
+        if (board.getSquareAttackers(static_cast<Square>(toSquare), occupiedWithoutKing) & opponentPieces) {
+            continue;
+        }
+
         const Move move = encodeMove(fromSquare, toSquare);
 
         moves.moves[moves.size] = move;
         moves.size++;
     }
 
+    // Castling is a quiet move that is never legal while in check
+    if (type != ALL || isInCheck) {
+        return;
+    }
+
     const uint8_t castlingRights = board.getCastlingRights();
 
     if constexpr (color == WHITE) {
-        if (castlingRights & WHITE_KINGSIDE && board.canCastle<WHITE_KINGSIDE>()) {
+        if (castlingRights & WHITE_KINGSIDE && board.canCastle<WHITE_KINGSIDE>()
+            && isCastlingPathSafe<color>(board, WHITE_KINGSIDE_CASTLE_PATH)) {
             const Move move = encodeMove(E1, G1, CASTLING);
 
             moves.moves[moves.size] = move;
             moves.size++;
         }
 
-        if (castlingRights & WHITE_QUEENSIDE && board.canCastle<WHITE_QUEENSIDE>()) {
+        if (castlingRights & WHITE_QUEENSIDE && board.canCastle<WHITE_QUEENSIDE>()
+            && isCastlingPathSafe<color>(board, WHITE_QUEENSIDE_CASTLE_PATH)) {
             const Move move = encodeMove(E1, C1, CASTLING);
 
             moves.moves[moves.size] = move;
             moves.size++;
         }
     } else if constexpr (color == BLACK) {
-        if (castlingRights & BLACK_KINGSIDE && board.canCastle<BLACK_KINGSIDE>()) {
+        if (castlingRights & BLACK_KINGSIDE && board.canCastle<BLACK_KINGSIDE>()
+            && isCastlingPathSafe<color>(board, BLACK_KINGSIDE_CASTLE_PATH)) {
             const Move move = encodeMove(E8, G8, CASTLING);
 
             moves.moves[moves.size] = move;
             moves.size++;
         }
 
-        if (castlingRights & BLACK_QUEENSIDE && board.canCastle<BLACK_QUEENSIDE>()) {
+        if (castlingRights & BLACK_QUEENSIDE && board.canCastle<BLACK_QUEENSIDE>()
+            && isCastlingPathSafe<color>(board, BLACK_QUEENSIDE_CASTLE_PATH)) {
             const Move move = encodeMove(E8, C8, CASTLING);
 
             moves.moves[moves.size] = move;
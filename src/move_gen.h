@@ -21,8 +21,10 @@
 
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include "board.h"
+#include "constants.h"
 #include "move.h"
 #include "types.h"
 
@@ -34,7 +36,19 @@ enum GenerationType : uint8_t {
 };
 
 /**
- * \brief Generates all pseudo-legal moves for all pieces of a certain color for a given color and generation type.
+ * \brief The pieces of one color that are pinned to their king, together with the squares they may still move to.
+ *
+ * Only the entries of rays that belong to a pinned square are written, the others are left uninitialized.
+ */
+struct PinMasks {
+    uint64_t pinned = 0;
+    std::array<uint64_t, SQUARES> rays;
+};
+
+/**
+ * \brief Generates all legal moves for all pieces of a certain color for a given color and generation type.
+ *
+ * The generated moves never leave the own king in check, so callers do not have to verify them after making them.
  * \tparam color The color of the pieces to generate moves for.
  * \tparam type The type of moves to generate (e.g., all moves, captures, quiet moves).
  * \param board The board object for which to generate moves.
@@ -44,68 +58,94 @@ template <PieceColor color, GenerationType type>
 void generateMoves(const Board& board, MoveList& moves);
 
 /**
- * \brief Generates all pseudo-legal pawn moves for a given color and generation type.
+ * \brief Finds the pieces of the given color that are pinned to their own king.
+ * \tparam color The color of the king and the pinned pieces.
+ * \param board The board object to find the pins in.
+ * \param kingSquare The square of the king of the given color.
+ * \return The pinned pieces and, for each of them, the squares they can move to without exposing the king.
+ */
+template <PieceColor color>
+PinMasks getPinMasks(const Board& board, Square kingSquare);
+
+/**
+ * \brief Generates all legal pawn moves for a given color and generation type, except for en passant captures.
  * \tparam color The color of the pawns to generate moves for.
  * \tparam type The type of moves to generate (e.g., all moves, captures, quiet moves).
  * \param board The board object for which to generate moves.
  * \param[out] moves The list to store the generated moves.
  * \param genMask The mask to filter out invalid moves.
+ * \param pawnBB The pawns to generate moves for.
  */
 template <PieceColor color, GenerationType type>
-void generatePawnMoves(const Board& board, MoveList& moves, uint64_t genMask);
+void generatePawnMoves(const Board& board, MoveList& moves, uint64_t genMask, uint64_t pawnBB);
+
+/**
+ * \brief Generates all legal en passant captures for a given color.
+ * \tparam color The color of the pawns to generate moves for.
+ * \param board The board object for which to generate moves.
+ * \param[out] moves The list to store the generated moves.
+ * \param kingSquare The square of the king of the given color.
+ */
+template <PieceColor color>
+void generateEnPassantMoves(const Board& board, MoveList& moves, Square kingSquare);
 
 /**
- * \brief Generates all pseudo-legal knight moves for a given color and generation type.
+ * \brief Generates all legal knight moves for a given color and generation type.
  * \tparam color The color of the knights to generate moves for.
  * \tparam type The type of moves to generate (e.g., all moves, captures, quiet moves).
  * \param board The board object for which to generate moves.
  * \param[out] moves The list to store the generated moves.
  * \param genMask The mask to filter out invalid moves.
+ * \param pins The pinned pieces of the given color.
  */
 template <PieceColor color, GenerationType type>
-void generateKnightMoves(const Board& board, MoveList& moves, uint64_t genMask);
+void generateKnightMoves(const Board& board, MoveList& moves, uint64_t genMask, const PinMasks& pins);
 
 /**
- * \brief Generates all pseudo-legal bishop moves for a given color and generation type.
+ * \brief Generates all legal bishop moves for a given color and generation type.
  * \tparam color The color of the bishops to generate moves for.
  * \tparam type The type of moves to generate (e.g., all moves, captures, quiet moves).
  * \param board The board object for which to generate moves.
  * \param[out] moves The list to store the generated moves.
  * \param genMask The mask to filter out invalid moves.
+ * \param pins The pinned pieces of the given color.
  */
 template <PieceColor color, GenerationType type>
-void generateBishopMoves(const Board& board, MoveList& moves, uint64_t genMask);
+void generateBishopMoves(const Board& board, MoveList& moves, uint64_t genMask, const PinMasks& pins);
 
 /**
- * \brief Generates all pseudo-legal rook moves for a given color and generation type.
+ * \brief Generates all legal rook moves for a given color and generation type.
  * \tparam color The color of the rooks to generate moves for.
  * \tparam type The type of moves to generate (e.g., all moves, captures, quiet moves).
  * \param board The board object for which to generate moves.
  * \param[out] moves The list to store the generated moves.
  * \param genMask The mask to filter out invalid moves.
+ * \param pins The pinned pieces of the given color.
  */
 template <PieceColor color, GenerationType type>
-void generateRookMoves(const Board& board, MoveList& moves, uint64_t genMask);
+void generateRookMoves(const Board& board, MoveList& moves, uint64_t genMask, const PinMasks& pins);
 
 /**
- * \brief Generates all pseudo-legal queen moves for a given color and generation type.
+ * \brief Generates all legal queen moves for a given color and generation type.
  * \tparam color The color of the queens to generate moves for.
  * \tparam type The type of moves to generate (e.g., all moves, captures, quiet moves).
  * \param board The board object for which to generate moves.
  * \param[out] moves The list to store the generated moves.
  * \param genMask The mask to filter out invalid moves.
+ * \param pins The pinned pieces of the given color.
  */
 template <PieceColor color, GenerationType type>
-void generateQueenMoves(const Board& board, MoveList& moves, uint64_t genMask);
+void generateQueenMoves(const Board& board, MoveList& moves, uint64_t genMask, const PinMasks& pins);
 
 /**
- * \brief Generates all pseudo-legal king moves for a given color and generation type.
+ * \brief Generates all legal king moves for a given color and generation type.
  * \tparam color The color of the king to generate moves for.
  * \tparam type The type of moves to generate (e.g., all moves, captures, quiet moves).
  * \param board The board object for which to generate moves.
  * \param[out] moves The list to store the generated moves.
  * \param genMask The mask to filter out invalid moves.
+ * \param isInCheck Whether the king is currently in check.
  */
 template <PieceColor color, GenerationType type>
-void generateKingMoves(const Board& board, MoveList& moves, uint64_t genMask);
+void generateKingMoves(const Board& board, MoveList& moves, uint64_t genMask, bool isInCheck);
 } // namespace Zagreus
@@ -82,10 +82,10 @@ void MovePicker::score(Board& board) {
     }
 
     uint64_t zobristHash = board.getZobristHash();
-    TTEntry* entry = tt->getEntry(zobristHash);
+    TTEntry entry{};
 
-    if (entry != nullptr) {
-        ttMove = entry->bestMove;
+    if (tt->getEntry(zobristHash, entry)) {
+        ttMove = entry.bestMove;
 
         if (ttMove == pvMove) {
             ttMove = NO_MOVE;
@@ -0,0 +1,313 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "nnue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#ifdef ZAGREUS_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+#include "bitwise.h"
+#include "board.h"
+#include "cpu.h"
+
+namespace Zagreus {
+// The evaluation has to stay clear of the mate scores
+constexpr int NNUE_MAX_EVAL = 20000;
+
+static std::unique_ptr<NNUENetwork> network{};
+
+static void addWeightsScalar(int16_t* values, const int16_t* weights) {
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; ++i) {
+        values[i] = static_cast<int16_t>(values[i] + weights[i]);
+    }
+}
+
+static void subtractWeightsScalar(int16_t* values, const int16_t* weights) {
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; ++i) {
+        values[i] = static_cast<int16_t>(values[i] - weights[i]);
+    }
+}
+
+static int64_t outputSumScalar(const int16_t* us, const int16_t* them, const int16_t* weights) {
+    int64_t sum = 0;
+
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; ++i) {
+        sum += std::clamp<int>(us[i], 0, NNUE_QA) * weights[i];
+        sum += std::clamp<int>(them[i], 0, NNUE_QA) * weights[NNUE_HIDDEN_SIZE + i];
+    }
+
+    return sum;
+}
+
+#ifdef ZAGREUS_X86_DISPATCH
+ZAGREUS_TARGET_SSE2 static void addWeightsSSE2(int16_t* values, const int16_t* weights) {
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; i += 8) {
+        auto* target = reinterpret_cast<__m128i*>(values + i);
+        const __m128i weightVector = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + i));
+
+        _mm_store_si128(target, _mm_add_epi16(_mm_load_si128(target), weightVector));
+    }
+}
+
+ZAGREUS_TARGET_SSE2 static void subtractWeightsSSE2(int16_t* values, const int16_t* weights) {
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; i += 8) {
+        auto* target = reinterpret_cast<__m128i*>(values + i);
+        const __m128i weightVector = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + i));
+
+        _mm_store_si128(target, _mm_sub_epi16(_mm_load_si128(target), weightVector));
+    }
+}
+
+ZAGREUS_TARGET_SSE2 static int64_t outputSumSSE2(const int16_t* us, const int16_t* them, const int16_t* weights) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i maxActivation = _mm_set1_epi16(NNUE_QA);
+    __m128i sum = _mm_setzero_si128();
+
+    for (const int16_t* values : {us, them}) {
+        for (int i = 0; i < NNUE_HIDDEN_SIZE; i += 8) {
+            const __m128i value = _mm_load_si128(reinterpret_cast<const __m128i*>(values + i));
+            const __m128i activation = _mm_min_epi16(_mm_max_epi16(value, zero), maxActivation);
+            const __m128i weight = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + i));
+
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(activation, weight));
+        }
+
+        weights += NNUE_HIDDEN_SIZE;
+    }
+
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+ZAGREUS_TARGET_AVX2 static void addWeightsAVX2(int16_t* values, const int16_t* weights) {
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; i += 16) {
+        auto* target = reinterpret_cast<__m256i*>(values + i);
+        const __m256i weightVector = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i));
+
+        _mm256_store_si256(target, _mm256_add_epi16(_mm256_load_si256(target), weightVector));
+    }
+}
+
+ZAGREUS_TARGET_AVX2 static void subtractWeightsAVX2(int16_t* values, const int16_t* weights) {
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; i += 16) {
+        auto* target = reinterpret_cast<__m256i*>(values + i);
+        const __m256i weightVector = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i));
+
+        _mm256_store_si256(target, _mm256_sub_epi16(_mm256_load_si256(target), weightVector));
+    }
+}
+
+ZAGREUS_TARGET_AVX2 static int64_t outputSumAVX2(const int16_t* us, const int16_t* them, const int16_t* weights) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i maxActivation = _mm256_set1_epi16(NNUE_QA);
+    __m256i sum = _mm256_setzero_si256();
+
+    for (const int16_t* values : {us, them}) {
+        for (int i = 0; i < NNUE_HIDDEN_SIZE; i += 16) {
+            const __m256i value = _mm256_load_si256(reinterpret_cast<const __m256i*>(values + i));
+            const __m256i activation = _mm256_min_epi16(_mm256_max_epi16(value, zero), maxActivation);
+            const __m256i weight = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i));
+
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(activation, weight));
+        }
+
+        weights += NNUE_HIDDEN_SIZE;
+    }
+
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum128);
+}
+#endif
+
+/**
+ * \brief The kernels of one instruction set. The output sum takes both clipped perspectives, the side to move first.
+ */
+struct NNUEKernels {
+    void (*addWeights)(int16_t* values, const int16_t* weights);
+    void (*subtractWeights)(int16_t* values, const int16_t* weights);
+    int64_t (*outputSum)(const int16_t* us, const int16_t* them, const int16_t* weights);
+};
+
+static NNUEKernels getKernels(const InstructionSet instructionSet) {
+#ifdef ZAGREUS_X86_DISPATCH
+    if (instructionSet == AVX2) {
+        return {addWeightsAVX2, subtractWeightsAVX2, outputSumAVX2};
+    }
+
+    if (instructionSet == SSE2) {
+        return {addWeightsSSE2, subtractWeightsSSE2, outputSumSSE2};
+    }
+#endif
+
+    return {addWeightsScalar, subtractWeightsScalar, outputSumScalar};
+}
+
+static InstructionSet selectedInstructionSet = detectInstructionSet();
+static NNUEKernels kernels = getKernels(selectedInstructionSet);
+
+/**
+ * \brief Applies a feature change to both perspectives of an accumulator.
+ */
+static void applyChange(Accumulator& accumulator, const FeatureChange& change) {
+    for (const PieceColor perspective : {WHITE, BLACK}) {
+        const int featureIndex = getFeatureIndex(perspective, change.piece, change.square);
+        const int16_t* weights = &network->featureWeights[featureIndex * NNUE_HIDDEN_SIZE];
+
+        if (change.added) {
+            kernels.addWeights(accumulator.values[perspective], weights);
+        } else {
+            kernels.subtractWeights(accumulator.values[perspective], weights);
+        }
+    }
+}
+
+/**
+ * \brief Scales the output layer sum to centipawns.
+ */
+static int scaleOutput(const int64_t sum) {
+    const int64_t eval = (sum + network->outputBias) * NNUE_SCALE / (NNUE_QA * NNUE_QB);
+
+    return static_cast<int>(std::clamp<int64_t>(eval, -NNUE_MAX_EVAL, NNUE_MAX_EVAL));
+}
+
+void AccumulatorStack::reset(const Board& board) {
+    if (entries.empty()) {
+        entries.resize(MAX_PLIES + 1);
+    }
+
+    top = 0;
+    entries[0].changeCount = 0;
+    entries[0].computed = true;
+    refreshAccumulator(board, entries[0].accumulator);
+}
+
+const Accumulator& AccumulatorStack::update() {
+    int computedIndex = top;
+
+    while (!entries[computedIndex].computed) {
+        // The root is always computed
+        assert(computedIndex > 0);
+        --computedIndex;
+    }
+
+    for (int index = computedIndex + 1; index <= top; ++index) {
+        Entry& entry = entries[index];
+
+        entry.accumulator = entries[index - 1].accumulator;
+
+        for (int i = 0; i < entry.changeCount; ++i) {
+            applyChange(entry.accumulator, entry.changes[i]);
+        }
+
+        entry.computed = true;
+    }
+
+    return entries[top].accumulator;
+}
+
+bool loadNetwork(const std::string& path) {
+    NNUEFileHeader header{};
+    const NNUEFileHeader expectedHeader{};
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return false;
+    }
+
+    if (std::memcmp(header.magic, expectedHeader.magic, sizeof(header.magic)) != 0
+        || header.version != expectedHeader.version || header.inputSize != expectedHeader.inputSize
+        || header.hiddenSize != expectedHeader.hiddenSize) {
+        return false;
+    }
+
+    auto loadedNetwork = std::make_unique<NNUENetwork>();
+    int8_t outputWeights[COLORS * NNUE_HIDDEN_SIZE];
+
+    file.read(reinterpret_cast<char*>(loadedNetwork->featureWeights), sizeof(loadedNetwork->featureWeights));
+    file.read(reinterpret_cast<char*>(loadedNetwork->featureBiases), sizeof(loadedNetwork->featureBiases));
+    file.read(reinterpret_cast<char*>(outputWeights), sizeof(outputWeights));
+    file.read(reinterpret_cast<char*>(&loadedNetwork->outputBias), sizeof(loadedNetwork->outputBias));
+
+    // The file has to end exactly after the weights
+    if (!file || file.peek() != std::ifstream::traits_type::eof()) {
+        return false;
+    }
+
+    std::copy_n(outputWeights, COLORS * NNUE_HIDDEN_SIZE, loadedNetwork->outputWeights);
+    network = std::move(loadedNetwork);
+    return true;
+}
+
+bool isNetworkLoaded() {
+    return network != nullptr;
+}
+
+void refreshAccumulator(const Board& board, Accumulator& accumulator) {
+    assert(network != nullptr);
+
+    for (const PieceColor perspective : {WHITE, BLACK}) {
+        std::copy_n(network->featureBiases, NNUE_HIDDEN_SIZE, accumulator.values[perspective]);
+    }
+
+    uint64_t occupied = board.getOccupiedBitboard();
+
+    while (occupied) {
+        const uint8_t square = popLsb(occupied);
+
+        applyChange(accumulator, {board.getPieceOnSquare(square), square, true});
+    }
+}
+
+int forwardNetwork(const Accumulator& accumulator, const PieceColor sideToMove) {
+    const int16_t* us = accumulator.values[sideToMove];
+    const int16_t* them = accumulator.values[!sideToMove];
+
+    return scaleOutput(kernels.outputSum(us, them, network->outputWeights));
+}
+
+int forwardNetworkScalar(const Accumulator& accumulator, const PieceColor sideToMove) {
+    const int16_t* us = accumulator.values[sideToMove];
+    const int16_t* them = accumulator.values[!sideToMove];
+
+    return scaleOutput(outputSumScalar(us, them, network->outputWeights));
+}
+
+void setNNUEInstructionSet(const InstructionSet instructionSet) {
+    selectedInstructionSet = std::min(instructionSet, detectInstructionSet());
+    kernels = getKernels(selectedInstructionSet);
+}
+
+InstructionSet getNNUEInstructionSet() {
+    return selectedInstructionSet;
+}
+
+int evaluateNNUE(const Board& board, AccumulatorStack& stack) {
+    return forwardNetwork(stack.update(), board.getSideToMove());
+}
+} // namespace Zagreus
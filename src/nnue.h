@@ -0,0 +1,218 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "constants.h"
+#include "cpu.h"
+#include "types.h"
+
+namespace Zagreus {
+class Board;
+
+constexpr uint32_t NNUE_FILE_VERSION = 1;
+constexpr int NNUE_INPUT_SIZE = COLORS * PIECE_TYPES * SQUARES;
+constexpr int NNUE_HIDDEN_SIZE = 256;
+// Quantization of the hidden layer activation and of the output weights
+constexpr int NNUE_QA = 255;
+constexpr int NNUE_QB = 64;
+// Scale of the network output to centipawns
+constexpr int NNUE_SCALE = 400;
+// The most feature changes a single move can cause (castling)
+constexpr int NNUE_MAX_CHANGES = 4;
+
+/**
+ * \brief The weights of a (768 -> 256)x2 -> 1 network. The feature weights of the hidden layer are shared by both
+ * perspectives, the output layer has separate weights for the side to move and the other side.
+ */
+struct alignas(64) NNUENetwork {
+    int16_t featureWeights[NNUE_INPUT_SIZE * NNUE_HIDDEN_SIZE];
+    int16_t featureBiases[NNUE_HIDDEN_SIZE];
+    // Stored as int8 in the file, widened on load so the output layer can use 16-bit multiply-adds
+    int16_t outputWeights[COLORS * NNUE_HIDDEN_SIZE];
+    int32_t outputBias;
+};
+
+/**
+ * \brief The header of a network file. A file with a different version or layer sizes is rejected.
+ */
+struct NNUEFileHeader {
+    char magic[8]{'Z', 'A', 'G', 'R', 'N', 'N', 'U', 'E'};
+    uint32_t version = NNUE_FILE_VERSION;
+    uint32_t inputSize = NNUE_INPUT_SIZE;
+    uint32_t hiddenSize = NNUE_HIDDEN_SIZE;
+    uint32_t padding = 0;
+};
+
+/**
+ * \brief The hidden layer values of both perspectives, before the activation.
+ */
+struct alignas(64) Accumulator {
+    int16_t values[COLORS][NNUE_HIDDEN_SIZE];
+};
+
+/**
+ * \brief A piece that was placed on or removed from a square.
+ */
+struct FeatureChange {
+    Piece piece;
+    uint8_t square;
+    bool added;
+};
+
+/**
+ * \brief Gets the index of the input feature of a piece on a square, as seen from one perspective. The board is flipped
+ * for black, so both perspectives see their own pieces on the first 384 features.
+ * \param perspective The color the board is seen from.
+ * \param piece The piece.
+ * \param square The square of the piece.
+ * \return The feature index.
+ */
+[[nodiscard]] constexpr int getFeatureIndex(const PieceColor perspective, const Piece piece, const uint8_t square) {
+    const int relativeColor = getPieceColor(piece) == perspective ? 0 : 1;
+    const int relativeSquare = perspective == WHITE ? square : square ^ 56;
+
+    return (relativeColor * PIECE_TYPES + getPieceType(piece)) * SQUARES + relativeSquare;
+}
+
+/**
+ * \brief A stack of accumulators with one entry per ply, owned by a single search thread. Making a move pushes an
+ * entry that only records which features changed. The accumulator of an entry is computed when the position is
+ * evaluated, by applying the changes on top of the closest computed entry below it. The root is always computed.
+ */
+class AccumulatorStack {
+private:
+    struct Entry {
+        Accumulator accumulator{};
+        FeatureChange changes[NNUE_MAX_CHANGES]{};
+        uint8_t changeCount = 0;
+        bool computed = false;
+    };
+
+    std::vector<Entry> entries{};
+    int top = 0;
+
+public:
+    /**
+     * \brief Removes all entries but the root and computes the root from scratch. Allocates the stack on first use.
+     * \param board The board the stack belongs to, in the root position.
+     */
+    void reset(const Board& board);
+
+    /**
+     * \brief Pushes an entry for a new move, which starts without feature changes.
+     */
+    void push() {
+        assert(top + 1 < static_cast<int>(entries.size()));
+        Entry& entry = entries[++top];
+
+        entry.changeCount = 0;
+        entry.computed = false;
+    }
+
+    /**
+     * \brief Removes the entry of the last move.
+     */
+    void pop() {
+        assert(top > 0);
+        --top;
+    }
+
+    /**
+     * \brief Records that a piece was placed on or removed from a square in the position of the top entry. The root
+     * entry is computed from scratch by reset, so changes to it are not recorded.
+     */
+    void addChange(const Piece piece, const uint8_t square, const bool added) {
+        if (top == 0) {
+            return;
+        }
+
+        Entry& entry = entries[top];
+
+        assert(entry.changeCount < NNUE_MAX_CHANGES);
+        entry.changes[entry.changeCount++] = {piece, square, added};
+    }
+
+    /**
+     * \brief Computes the accumulator of the current position, if it was not computed yet.
+     * \return The accumulator of the current position.
+     */
+    const Accumulator& update();
+};
+
+/**
+ * \brief Loads a network from a file. The file starts with an NNUEFileHeader, the weights follow in the order of
+ * NNUENetwork with the output weights stored as int8. The loaded network replaces the previous one only if the whole
+ * file is valid.
+ * \param path The path to the network file.
+ * \return True if the network was loaded, false if the file could not be read or has a different format.
+ */
+[[nodiscard]] bool loadNetwork(const std::string& path);
+
+/**
+ * \brief Checks if a network has been loaded.
+ */
+[[nodiscard]] bool isNetworkLoaded();
+
+/**
+ * \brief Computes the accumulator of a position from scratch.
+ * \param board The position.
+ * \param accumulator Set to the hidden layer values of both perspectives.
+ */
+void refreshAccumulator(const Board& board, Accumulator& accumulator);
+
+/**
+ * \brief Computes the output of the network from the accumulator of a position.
+ * \param accumulator The accumulator of the position.
+ * \param sideToMove The side to move in the position.
+ * \return The evaluation in centipawns, from the perspective of the side to move.
+ */
+[[nodiscard]] int forwardNetwork(const Accumulator& accumulator, PieceColor sideToMove);
+
+/**
+ * \brief Same as forwardNetwork, but without vector instructions. Used to verify the vectorized kernels.
+ */
+[[nodiscard]] int forwardNetworkScalar(const Accumulator& accumulator, PieceColor sideToMove);
+
+/**
+ * \brief Selects the kernels used by the network. On startup, the kernels of the best instruction set the CPU
+ * supports are selected.
+ * \param instructionSet The instruction set to use. Limited to the instruction sets the CPU supports.
+ */
+void setNNUEInstructionSet(InstructionSet instructionSet);
+
+/**
+ * \brief Gets the instruction set of the kernels used by the network.
+ */
+[[nodiscard]] InstructionSet getNNUEInstructionSet();
+
+/**
+ * \brief Evaluates the current position of a board with the loaded network, updating the accumulator stack.
+ * \param board The board, which has the stack attached.
+ * \param stack The accumulator stack of the board.
+ * \return The evaluation in centipawns, from the perspective of the side to move.
+ */
+[[nodiscard]] int evaluateNNUE(const Board& board, AccumulatorStack& stack);
+} // namespace Zagreus
@@ -0,0 +1,38 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pawn_hash.h"
+#include <algorithm>
+#include <bit>
+
+namespace Zagreus {
+void PawnHashTable::resize(const int megaBytes) {
+    const uint64_t bytes = static_cast<uint64_t>(std::max(megaBytes, 1)) * 1024 * 1024;
+    const uint64_t entryCount = std::bit_floor(bytes / sizeof(PawnHashEntry));
+
+    entries.assign(entryCount, PawnHashEntry{});
+    entries.shrink_to_fit();
+    indexMask = entryCount - 1;
+}
+
+void PawnHashTable::clear() {
+    std::ranges::fill(entries, PawnHashEntry{});
+}
+} // namespace Zagreus
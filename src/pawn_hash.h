@@ -0,0 +1,83 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "constants.h"
+
+namespace Zagreus {
+/**
+ * \brief The pawn attack maps of a position, which only depend on the pawns on the board. The material and PST values
+ * of the pawns are not part of the entry, the board keeps track of those. Aligned to a cache line, so a lookup touches
+ * one line.
+ */
+struct alignas(64) PawnHashEntry {
+    uint64_t key = 0;
+    uint64_t attacks[COLORS]{};
+    uint64_t attackedBy2[COLORS]{};
+    uint64_t attackSpans[COLORS]{};
+};
+
+static_assert(sizeof(PawnHashEntry) == 64);
+
+/**
+ * \brief A direct-mapped table of pawn attack maps, indexed by the pawn zobrist hash. Every search thread owns one, so
+ * it needs no synchronization. The pawn structure rarely changes during a search, so most lookups are hits.
+ *
+ * An empty entry has key 0 and no attacks, which is exactly the entry of a position without pawns, whose pawn hash is
+ * 0.
+ */
+class PawnHashTable {
+private:
+    std::vector<PawnHashEntry> entries{};
+    uint64_t indexMask = 0;
+
+public:
+    static constexpr int DEFAULT_SIZE_MB = 1;
+
+    PawnHashTable() {
+        resize(DEFAULT_SIZE_MB);
+    }
+
+    /**
+     * \brief Resizes the table to the largest power of two amount of entries that fits in the given size. Clears the
+     * table.
+     * \param megaBytes The size of the table in megabytes, at least 1.
+     */
+    void resize(int megaBytes);
+
+    /**
+     * \brief Removes all entries from the table.
+     */
+    void clear();
+
+    /**
+     * \brief Gets the entry a pawn structure maps to. The caller fills the entry if the key does not match.
+     * \param pawnZobristHash The pawn zobrist hash of the position.
+     * \return The entry at the index of the hash.
+     */
+    [[nodiscard]] PawnHashEntry& getEntry(const uint64_t pawnZobristHash) {
+        return entries[pawnZobristHash & indexMask];
+    }
+};
+} // namespace Zagreus
@@ -19,70 +19,329 @@
  */
 
 #include "perft.h"
+#include <algorithm>
 #include <cassert>
 #include <array>
+#include <atomic>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 #include "move.h"
 #include "move_gen.h"
 #include "types.h"
 
 namespace Zagreus {
 /**
- * \brief Performs a perft test on the given board to a specified depth.
- *
- * This function recursively generates all possible moves up to a given depth and counts the number of nodes reached.
- *
- * \param board The board object on which to perform the perft.
- * \param depth The depth to which moves should be generated.
- * \param printNodes If true, prints the number of nodes for each move at the root level.
- * \return The number of nodes reached.
+ * \brief A subtree counted by one of the perft threads: a root move and, when splitting at depth 2, one reply to it.
  */
-uint64_t perft(Board& board, const int depth, bool printNodes) {
-    assert(depth >= 0);
+struct PerftTask {
+    int rootMoveIndex = 0;
+    Move reply = NO_MOVE;
+    uint64_t nodes = 0;
+};
+
+/**
+ * \brief Generates all legal moves for the side to move.
+ */
+static void generateLegalMoves(const Board& board, MoveList& moveList) {
+    if (board.getSideToMove() == WHITE) {
+        generateMoves<WHITE, ALL>(board, moveList);
+    } else {
+        generateMoves<BLACK, ALL>(board, moveList);
+    }
+}
+
+/**
+ * \brief Prints the number of nodes below a root move in the format of perft divide.
+ */
+static void printRootMoveNodes(const Move move, const uint64_t nodes) {
+    std::cout << getMoveNotation(move) << ": " << nodes << std::endl;
+}
+
+PerftTable::PerftTable(const uint64_t sizeMB) {
+    entryCount = std::max<uint64_t>(1, sizeMB * 1024 * 1024 / sizeof(PerftEntry));
+    entries = std::make_unique<PerftEntry[]>(entryCount);
+}
+
+PerftEntry& PerftTable::getEntry(const uint64_t zobristHash, const int depth) const {
+    const uint64_t indexHash = zobristHash ^ (static_cast<uint64_t>(depth) * 0x9E3779B97F4A7C15ULL);
+    const auto index = static_cast<uint64_t>(static_cast<unsigned __int128>(indexHash) * entryCount >> 64);
+
+    return entries[index];
+}
+
+bool PerftTable::probe(const uint64_t zobristHash, const int depth, uint64_t& nodes) const {
+    const PerftEntry& entry = getEntry(zobristHash, depth);
+    const uint64_t data = entry.data.load(std::memory_order_relaxed);
+    const uint64_t key = entry.key.load(std::memory_order_relaxed);
+
+    if ((key ^ data) != zobristHash || (data & 0xFF) != static_cast<uint64_t>(depth)) {
+        return false;
+    }
+
+    nodes = data >> 8;
+    return true;
+}
+
+void PerftTable::store(const uint64_t zobristHash, const int depth, const uint64_t nodes) {
+    PerftEntry& entry = getEntry(zobristHash, depth);
+    const uint64_t data = nodes << 8 | static_cast<uint8_t>(depth);
+
+    entry.key.store(zobristHash ^ data, std::memory_order_relaxed);
+    entry.data.store(data, std::memory_order_relaxed);
+}
 
+void PerftTable::addStatistics(const uint64_t probeCount, const uint64_t hitCount) {
+    probes.fetch_add(probeCount, std::memory_order_relaxed);
+    hits.fetch_add(hitCount, std::memory_order_relaxed);
+}
+
+/**
+ * \brief The table probes and hits of one perft thread, added to the table when the thread is done.
+ */
+struct PerftTableStatistics {
+    uint64_t probes = 0;
+    uint64_t hits = 0;
+};
+
+/**
+ * \brief Counts the nodes of a subtree, looking up and storing the counts of subtrees of depth 2 and deeper in the
+ * table if one is given. Depth 1 is bulk counted, which is cheaper than a table probe.
+ */
+static uint64_t countNodes(Board& board, const int depth, PerftTable* table, PerftTableStatistics& statistics) {
     if (depth == 0) {
         return 1;
     }
 
+    const bool useTable = table && depth >= 2;
     uint64_t nodes = 0;
+
+    if (useTable) {
+        statistics.probes += 1;
+
+        if (table->probe(board.getZobristHash(), depth, nodes)) {
+            statistics.hits += 1;
+            return nodes;
+        }
+    }
+
     MoveList moveList{};
-    const PieceColor sideToMove = board.getSideToMove();
 
-    if (sideToMove == WHITE) {
-        generateMoves<WHITE, ALL>(board, moveList);
-    } else {
-        generateMoves<BLACK, ALL>(board, moveList);
+    generateLegalMoves(board, moveList);
+
+    if (depth == 1) {
+        return moveList.size;
     }
 
     for (int i = 0; i < moveList.size; i++) {
         board.makeMove(moveList.moves[i]);
+        nodes += countNodes(board, depth - 1, table, statistics);
+        board.unmakeMove();
+    }
+
+    if (useTable) {
+        table->store(board.getZobristHash(), depth, nodes);
+    }
+
+    return nodes;
+}
+
+/**
+ * \brief Performs a perft test with the subtrees divided over multiple threads.
+ *
+ * Every thread counts subtrees on its own copy of the board, taking the next task from a shared counter until all
+ * tasks are done. From depth 3 the tree is split at depth 2, which gives many more and smaller tasks than the root
+ * moves alone and keeps all threads busy when a few root moves have much larger subtrees than the others.
+ *
+ * \param board The board object on which to perform the perft.
+ * \param depth The depth to which moves should be generated, at least 2.
+ * \param printNodes If true, prints the number of nodes for each move at the root level.
+ * \param threadCount The number of threads to use.
+ * \param table The table shared by all threads, or nullptr.
+ * \return The number of nodes reached.
+ */
+static uint64_t parallelPerft(Board& board, const int depth, const bool printNodes, const int threadCount,
+                              PerftTable* table) {
+    assert(depth >= 2);
+    MoveList rootMoves{};
+    std::vector<PerftTask> tasks{};
+    const bool splitAtReplies = depth >= 3;
+    const int subtreeDepth = splitAtReplies ? depth - 2 : depth - 1;
+
+    generateLegalMoves(board, rootMoves);
+
+    for (int i = 0; i < rootMoves.size; i++) {
+        if (!splitAtReplies) {
+            tasks.push_back(PerftTask{i});
+            continue;
+        }
+
+        MoveList replies{};
 
-        if (sideToMove == WHITE) {
-            if (!board.isPositionLegal<WHITE>()) {
-                board.unmakeMove();
-                continue;
+        board.makeMove(rootMoves.moves[i]);
+        generateLegalMoves(board, replies);
+        board.unmakeMove();
+
+        for (int j = 0; j < replies.size; j++) {
+            tasks.push_back(PerftTask{i, replies.moves[j]});
+        }
+    }
+
+    std::atomic<size_t> nextTask{0};
+    std::vector<std::thread> threads{};
+    const size_t usedThreads = std::min(static_cast<size_t>(threadCount), tasks.size());
+
+    for (size_t threadId = 0; threadId < usedThreads; threadId++) {
+        threads.emplace_back([&board, &tasks, &rootMoves, &nextTask, subtreeDepth, table] {
+            const auto threadBoard = std::make_unique<Board>();
+            PerftTableStatistics statistics{};
+
+            threadBoard->copyFrom(board);
+
+            for (size_t index = nextTask++; index < tasks.size(); index = nextTask++) {
+                PerftTask& task = tasks[index];
+
+                threadBoard->makeMove(rootMoves.moves[task.rootMoveIndex]);
+
+                if (task.reply != NO_MOVE) {
+                    threadBoard->makeMove(task.reply);
+                    task.nodes = countNodes(*threadBoard, subtreeDepth, table, statistics);
+                    threadBoard->unmakeMove();
+                } else {
+                    task.nodes = countNodes(*threadBoard, subtreeDepth, table, statistics);
+                }
+
+                threadBoard->unmakeMove();
             }
-        } else {
-            if (!board.isPositionLegal<BLACK>()) {
-                board.unmakeMove();
-                continue;
+
+            if (table) {
+                table->addStatistics(statistics.probes, statistics.hits);
             }
+        });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<uint64_t> rootMoveNodes(rootMoves.size, 0);
+    uint64_t nodes = 0;
+
+    for (const PerftTask& task : tasks) {
+        rootMoveNodes[task.rootMoveIndex] += task.nodes;
+        nodes += task.nodes;
+    }
+
+    if (printNodes) {
+        for (int i = 0; i < rootMoves.size; i++) {
+            printRootMoveNodes(rootMoves.moves[i], rootMoveNodes[i]);
         }
+    }
+
+    return nodes;
+}
+
+/**
+ * \brief Performs a perft test on the given board to a specified depth.
+ *
+ * This function recursively generates all possible moves up to a given depth and counts the number of nodes reached.
+ * Because the move generator only produces legal moves, the leaves are bulk counted: at depth 1 the number of nodes
+ * is the size of the move list and the moves are not made.
+ *
+ * \param board The board object on which to perform the perft.
+ * \param depth The depth to which moves should be generated.
+ * \param printNodes If true, prints the number of nodes for each move at the root level.
+ * \param threadCount The number of threads to divide the subtrees over.
+ * \param table The table to look up and store the node counts of subtrees in, or nullptr to count every subtree.
+ * \return The number of nodes reached.
+ */
+uint64_t perft(Board& board, const int depth, bool printNodes, const int threadCount, PerftTable* table) {
+    assert(depth >= 0);
+
+    if (threadCount > 1 && depth >= 2) {
+        return parallelPerft(board, depth, printNodes, threadCount, table);
+    }
 
-        uint64_t perftNodes = perft(board, depth - 1, false);
+    PerftTableStatistics statistics{};
 
-        if (printNodes) {
-            std::string moveNotation = getMoveNotation(moveList.moves[i]);
+    if (!printNodes || depth == 0) {
+        const uint64_t nodes = countNodes(board, depth, table, statistics);
 
-            std::cout << moveNotation << ": " << perftNodes << std::endl;
+        if (table) {
+            table->addStatistics(statistics.probes, statistics.hits);
         }
 
+        return nodes;
+    }
+
+    uint64_t nodes = 0;
+    MoveList moveList{};
+
+    generateLegalMoves(board, moveList);
+
+    for (int i = 0; i < moveList.size; i++) {
+        board.makeMove(moveList.moves[i]);
+
+        const uint64_t perftNodes = countNodes(board, depth - 1, table, statistics);
+
+        printRootMoveNodes(moveList.moves[i], perftNodes);
         nodes += perftNodes;
         board.unmakeMove();
     }
 
+    if (table) {
+        table->addStatistics(statistics.probes, statistics.hits);
+    }
+
     return nodes;
 }
-} // namespace Zagreus
 
+bool parsePerftSuiteLine(const std::string& line, PerftSuiteEntry& entry) {
+    std::istringstream fields(line);
+    std::string field;
+
+    entry = PerftSuiteEntry{};
+
+    if (!std::getline(fields, field, ';')) {
+        return false;
+    }
+
+    const size_t fenStart = field.find_first_not_of(" \t");
+    const size_t fenEnd = field.find_last_not_of(" \t\r");
+
+    if (fenStart == std::string::npos) {
+        return false;
+    }
+
+    entry.fen = field.substr(fenStart, fenEnd - fenStart + 1);
+
+    while (std::getline(fields, field, ';')) {
+        std::istringstream depthField(field);
+        std::string depthName;
+        uint64_t nodes = 0;
+
+        // Each field is "D<depth> <nodes>"
+        if (!(depthField >> depthName >> nodes) || depthName.size() < 2 || depthName[0] != 'D') {
+            return false;
+        }
+
+        try {
+            const int depth = std::stoi(depthName.substr(1));
+
+            if (depth <= 0) {
+                return false;
+            }
+
+            entry.depths.emplace_back(depth, nodes);
+        } catch (const std::exception& e) {
+            return false;
+        }
+    }
+
+    return !entry.depths.empty();
+}
+} // namespace Zagreus
@@ -20,20 +20,111 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "board.h"
 
 namespace Zagreus {
+/**
+ * \brief An entry of the perft table. data holds the node count in its upper 56 bits and the depth in its lower 8 bits,
+ * key holds the zobrist hash XORed with data. An entry that was torn by two threads writing it at the same time fails
+ * the verification, so a probe never returns the count of another position or depth.
+ */
+struct PerftEntry {
+    std::atomic<uint64_t> key{0};
+    std::atomic<uint64_t> data{0};
+};
+
+/**
+ * \brief A hash table that stores the node counts of perft subtrees by zobrist hash and depth, shared by all perft
+ * threads. Every entry is always replaced on a store.
+ */
+class PerftTable {
+public:
+    /**
+     * \brief Allocates a table of the given size. The table is zeroed, which never matches a probe.
+     * \param sizeMB The size of the table in megabytes, at least 1.
+     */
+    explicit PerftTable(uint64_t sizeMB);
+
+    /**
+     * \brief Looks up the node count of a subtree.
+     * \param zobristHash The zobrist hash of the position at the root of the subtree.
+     * \param depth The depth of the subtree.
+     * \param[out] nodes The node count, if found.
+     * \return True if the full key and the depth matched, false otherwise.
+     */
+    [[nodiscard]] bool probe(uint64_t zobristHash, int depth, uint64_t& nodes) const;
+
+    /**
+     * \brief Stores the node count of a subtree.
+     * \param zobristHash The zobrist hash of the position at the root of the subtree.
+     * \param depth The depth of the subtree.
+     * \param nodes The node count.
+     */
+    void store(uint64_t zobristHash, int depth, uint64_t nodes);
+
+    /**
+     * \brief Adds the probes and hits counted by one perft thread to the statistics of the table.
+     */
+    void addStatistics(uint64_t probeCount, uint64_t hitCount);
+
+    [[nodiscard]] uint64_t getProbes() const {
+        return probes.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t getHits() const {
+        return hits.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::unique_ptr<PerftEntry[]> entries{};
+    uint64_t entryCount = 0;
+    std::atomic<uint64_t> probes{0};
+    std::atomic<uint64_t> hits{0};
+
+    /**
+     * \brief Maps a position and depth to an entry with a multiply-high, so the table can have any amount of entries.
+     * The depth is mixed into the hash, so the counts of one position at different depths don't replace each other.
+     */
+    [[nodiscard]] PerftEntry& getEntry(uint64_t zobristHash, int depth) const;
+};
+
+/**
+ * \brief A position of a perft suite with the expected node count for every depth, as (depth, nodes) pairs.
+ */
+struct PerftSuiteEntry {
+    std::string fen;
+    std::vector<std::pair<int, uint64_t>> depths;
+};
+
+/**
+ * \brief Parses a line of a perft suite in EPD format, for example
+ * "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 ;D1 20 ;D2 400".
+ * \param line The line to parse.
+ * \param[out] entry The position and the expected node counts.
+ * \return True if the line has a position and at least one valid depth, false otherwise.
+ */
+[[nodiscard]] bool parsePerftSuiteLine(const std::string& line, PerftSuiteEntry& entry);
+
 /**
  * \brief Performs a perft test on the given board to a specified depth.
  *
  * This function recursively generates all possible moves up to a given depth and counts the number of nodes reached.
+ * Because the move generator only produces legal moves, the leaves are bulk counted: at depth 1 the number of nodes
+ * is the size of the move list and the moves are not made.
  *
  * \param board The board object on which to perform the perft.
  * \param depth The depth to which moves should be generated.
  * \param printNodes If true, prints the number of nodes for each move at the root level.
+ * \param threadCount The number of threads to divide the subtrees over, each with its own copy of the board.
+ * \param table The table to look up and store the node counts of subtrees in, or nullptr to count every subtree.
  * \return The number of nodes reached.
  */
-uint64_t perft(Board &board, int depth, bool printNodes = true);
-} // namespace Zagreus
\ No newline at end of file
+uint64_t perft(Board &board, int depth, bool printNodes = true, int threadCount = 1, PerftTable* table = nullptr);
+} // namespace Zagreus
@@ -161,8 +161,7 @@ int eg_king_table[64] = {
     -53, -34, -21, -11, -28, -14, -24, -43
 };
 
-int midgamePstTable[PIECES][SQUARES]{};
-int endgamePstTable[PIECES][SQUARES]{};
+Score pstTable[PIECES][SQUARES]{};
 
 int* getMidgameTable(const PieceType pieceType) {
     switch (pieceType) {
@@ -201,18 +200,22 @@ int* getEndgameTable(const PieceType pieceType) {
 void initializePst() {
     for (Piece piece = WHITE_PAWN; piece <= BLACK_KING; piece++) {
         for (Square square = A1; square <= H8; square++) {
-            const int midgamePieceValue = evalMaterialValues[MIDGAME][getPieceType(piece)];
-            const int endgamePieceValue = evalMaterialValues[ENDGAME][getPieceType(piece)];
-            const PieceColor color = getPieceColor(piece);
-
-            if (color == WHITE) {
-                midgamePstTable[piece][square] = midgamePieceValue + getMidgameTable(getPieceType(piece))[square ^ 56];
-                endgamePstTable[piece][square] = endgamePieceValue + getEndgameTable(getPieceType(piece))[square ^ 56];
-            } else {
-                midgamePstTable[piece][square] = midgamePieceValue + getMidgameTable(getPieceType(piece))[square];
-                endgamePstTable[piece][square] = endgamePieceValue + getEndgameTable(getPieceType(piece))[square];
-            }
+            const PieceType pieceType = getPieceType(piece);
+            // The tables start at A8, so white has to flip the square
+            const int tableSquare = getPieceColor(piece) == WHITE ? square ^ 56 : square;
+
+            const Score pstScore = makeScore(getMidgameTable(pieceType)[tableSquare],
+                                             getEndgameTable(pieceType)[tableSquare]);
+
+            pstTable[piece][square] = evalMaterialValues[pieceType] + pstScore;
         }
     }
 }
+
+// Filled during static initialization, because a board can be set up (e.g. by the position command) before the engine
+// setup. The material and PST tables are constant initialized, so they are complete at this point.
+[[maybe_unused]] static const bool pstTableInitialized = [] {
+    initializePst();
+    return true;
+}();
 } // namespace Zagreus
@@ -21,12 +21,21 @@
 
 #pragma once
 #include "constants.h"
+#include "score.h"
 
 namespace Zagreus {
 enum PieceType : uint8_t;
-extern int midgamePstTable[PIECES][SQUARES];
-extern int endgamePstTable[PIECES][SQUARES];
+// The material value plus the PST value of every piece on every square, packed so one load serves both phases
+extern Score pstTable[PIECES][SQUARES];
 
+// How much every piece type counts towards the game phase. Pawns and kings don't count.
+constexpr int PIECE_PHASES[PIECE_TYPES] = {0, 1, 1, 2, 4, 0};
+constexpr int TOTAL_PHASE = 24;
+
+/**
+ * \brief Fills pstTable from the material values and the midgame and endgame PSTs. Runs during static initialization,
+ * so it only has to be called again after those values changed.
+ */
 void initializePst();
 
 int* getMidgameTable(PieceType pieceType);
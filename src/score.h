@@ -0,0 +1,67 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace Zagreus {
+/**
+ * \brief A midgame and an endgame score packed into one 32-bit integer. The endgame score is stored in the upper 16
+ * bits and the midgame score in the lower 16 bits, as two's complement values.
+ *
+ * Scores can be added, subtracted and multiplied by an integer directly, which updates both halves at once. The
+ * borrow of a negative midgame score is taken from the endgame half, which getEndgameScore corrects by rounding. Both
+ * halves have to stay within the range of a 16-bit integer.
+ */
+using Score = int32_t;
+
+/**
+ * \brief Packs a midgame and an endgame score.
+ * \param midgameScore The midgame score.
+ * \param endgameScore The endgame score.
+ * \return The packed score.
+ */
+constexpr Score makeScore(const int midgameScore, const int endgameScore) {
+    return static_cast<Score>(static_cast<uint32_t>(endgameScore) << 16) + midgameScore;
+}
+
+/**
+ * \brief Gets the midgame half of a packed score.
+ * \param score The packed score.
+ * \return The midgame score.
+ */
+constexpr int getMidgameScore(const Score score) {
+    return static_cast<int16_t>(static_cast<uint16_t>(static_cast<uint32_t>(score)));
+}
+
+/**
+ * \brief Gets the endgame half of a packed score.
+ * \param score The packed score.
+ * \return The endgame score.
+ */
+constexpr int getEndgameScore(const Score score) {
+    return static_cast<int16_t>(static_cast<uint16_t>((static_cast<uint32_t>(score) + 0x8000) >> 16));
+}
+
+static_assert(getMidgameScore(makeScore(-5, 7)) == -5 && getEndgameScore(makeScore(-5, 7)) == 7);
+static_assert(getMidgameScore(makeScore(12, -300) * 3) == 36 && getEndgameScore(makeScore(12, -300) * 3) == -900);
+static_assert(getEndgameScore(makeScore(-1, -1) + makeScore(2, 1)) == 0);
+} // namespace Zagreus
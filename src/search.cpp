@@ -19,15 +19,18 @@
  */
 
 #include "search.h"
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <string>
+#include "analysis_db.h"
 #include "board.h"
 #include "constants.h"
 #include "eval.h"
 #include "move.h"
 #include "move_gen.h"
 #include "move_picker.h"
+#include "tablebase.h"
 #include "timeman.h"
 #include "tt.h"
 #include "types.h"
@@ -35,6 +38,8 @@
 
 namespace Zagreus {
 static TranspositionTable* tt = TranspositionTable::getTT();
+static Tablebases* tablebases = Tablebases::getTablebases();
+static AnalysisDatabase* analysisDatabase = AnalysisDatabase::getAnalysisDatabase();
 static int lmrTable[MAX_PLIES][MAX_MOVES]{};
 
 void initializeSearch() {
@@ -47,34 +52,112 @@ void initializeSearch() {
 
 
 // TODO: Support more search variables (infinite, max nodes, etc.)
+/**
+ * \brief Evaluates the board, using the evaluation cache of the search thread if it has one. The evaluation may stop
+ * early if the score is far outside the window, such evaluations are not cached. Uses the network instead of the
+ * handcrafted evaluation if the board has an accumulator stack attached.
+ * \param board The board to evaluate.
+ * \param thread The search thread that owns the cache and the hit/miss statistics.
+ * \param alpha The lower bound of the window.
+ * \param beta The upper bound of the window.
+ * \param isExact Set to true if the returned evaluation is the full evaluation.
+ * \return The static evaluation from the perspective of the side to move.
+ */
+static int evaluateCached(const Board& board, SearchThread& thread, const int alpha, const int beta, bool& isExact) {
+    int eval = 0;
+
+    if (thread.evalCache.isEnabled()) {
+        if (thread.evalCache.probe(board.getZobristHash(), eval)) {
+            thread.stats.evalCacheHits += 1;
+            isExact = true;
+            return eval;
+        }
+
+        thread.stats.evalCacheMisses += 1;
+    }
+
+    if (AccumulatorStack* accumulators = board.getAccumulatorStack()) {
+        eval = evaluateNNUE(board, *accumulators);
+        isExact = true;
+    } else {
+        eval = Evaluation(board, &thread.pawnTable).evaluate(alpha, beta, isExact);
+    }
+
+    if (isExact) {
+        thread.evalCache.store(board.getZobristHash(), eval);
+    } else {
+        thread.stats.lazyEvals += 1;
+    }
+
+    return eval;
+}
+
+/**
+ * \brief Probes the tablebases right after a capture or pawn move, as the 50-move rule is not in the tables.
+ * \param board The board.
+ * \param stats The stats of the searching thread.
+ * \param score Set to the score of the position for the side to move if it was found.
+ * \return True if the position was found in the tablebases, false otherwise.
+ */
+static bool probeTablebases(const Board& board, SearchStats& stats, int& score) {
+    TBResult result = TB_INVALID;
+
+    if (!tablebases->canProbe(board.getOccupiedBitboard()) || board.getHalfMoveClock() != 0
+        || !tablebases->probe(board, result)) {
+        return false;
+    }
+
+    stats.tbHits += 1;
+
+    if (result == TB_WIN) {
+        score = TB_WIN_SCORE - board.getPly();
+    } else if (result == TB_LOSS) {
+        score = -TB_WIN_SCORE + board.getPly();
+    } else {
+        score = DRAW_SCORE;
+    }
+
+    return true;
+}
+
 template <PieceColor color>
-Move search(Engine& engine, Board& board, SearchParams& params, SearchStats& stats) {
-    int depth = 1;
+Move search(Engine& engine, SearchThread& thread, SearchParams& params) {
+    Board& board = thread.board;
+    SearchStats& stats = thread.stats;
+    const bool isMainThread = thread.isMainThread();
+    // Let half of the helper threads start one ply deeper, so the threads don't all search the same depth at once
+    int depth = isMainThread ? 1 : 1 + (thread.id & 1);
     const int currentPly = board.getPly();
+    thread.rootPly = currentPly;
     int searchTime = calculateSearchTime<color>(params);
     const auto endTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(searchTime);
     const auto startTime = std::chrono::steady_clock::now();
     PvLine bestPvLine = PvLine{board.getPly()};
 
-    engine.setSearchStopped(false);
-
     while (!engine.isSearchStopped() && (currentPly + depth) < MAX_PLIES) {
         if (params.blackTime > 0 || params.whiteTime > 0) {
             // Don't start the next iteration if we are 10% away from the end time
             if (std::chrono::steady_clock::now() + std::chrono::milliseconds(searchTime / 10) > endTime) {
-                engine.setSearchStopped(true);
+                if (isMainThread) {
+                    engine.setSearchStopped(true);
+                }
+
                 break;
             }
         }
 
         if (params.depth > 0 && depth > params.depth) {
-            engine.setSearchStopped(true);
+            // Only the main thread decides when the search is done, helpers just stop iterating
+            if (isMainThread) {
+                engine.setSearchStopped(true);
+            }
+
             break;
         }
 
         PvLine pvLine = PvLine{board.getPly()};
 
-        const int score = pvSearch<color, ROOT>(engine, board, INITIAL_ALPHA, INITIAL_BETA, depth, stats, endTime,
+        const int score = pvSearch<color, ROOT>(engine, board, INITIAL_ALPHA, INITIAL_BETA, depth, thread, endTime,
                                                 pvLine);
         assert(score != INITIAL_ALPHA && score != INITIAL_BETA);
         assert(depth > 0);
@@ -95,20 +178,31 @@ Move search(Engine& engine, Board& board, SearchParams& params, SearchStats& sta
         stats.timeSpentMs = std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::steady_clock::now() - startTime).count();
         stats.depth = depth;
+        depth += 1;
+
+        if (!isMainThread) {
+            continue;
+        }
 
         // Make sure we don't divide by zero
         if (stats.timeSpentMs == 0) {
             stats.timeSpentMs = 1;
         }
 
-        const uint64_t totalNodesSearch = stats.nodesSearched + stats.qNodesSearched;
+        const uint64_t totalNodesSearch = engine.getNodesSearched();
         const uint64_t nps = static_cast<double>(totalNodesSearch) / (
                                  static_cast<double>(stats.timeSpentMs) / 1000.0);
+        // Stored after every iteration, so a search that is stopped early keeps its deepest finished result
+        if (analysisDatabase->isOpen()) {
+            analysisDatabase->store(board, stats.depth, stats.score, totalNodesSearch, bestPvLine);
+        }
+
         std::string pvString = parsePvLine(bestPvLine);
         engine.sendInfoMessage("depth " + std::to_string(stats.depth) + " score cp " + std::to_string(stats.score) +
                                " nodes " + std::to_string(totalNodesSearch) + " time " +
-                               std::to_string(stats.timeSpentMs) + " nps " + std::to_string(nps) + " pv " + pvString);
-        depth += 1;
+                               std::to_string(stats.timeSpentMs) + " nps " + std::to_string(nps) + " hashfull " +
+                               std::to_string(tt->getHashFull()) + " tbhits " + std::to_string(stats.tbHits) + " pv " +
+                               pvString);
     }
 
     if (bestPvLine.moves[0] == NO_MOVE) {
@@ -119,17 +213,8 @@ Move search(Engine& engine, Board& board, SearchParams& params, SearchStats& sta
         Move move;
         Move bestMove = NO_MOVE;
 
-        while (movePicker.next(move)) {
-            board.makeMove(move);
-
-            if (!board.isPositionLegal<color>()) {
-                board.unmakeMove();
-                continue;
-            }
-
+        if (movePicker.next(move)) {
             bestMove = move;
-            board.unmakeMove();
-            break;
         }
 
         assert(bestMove != NO_MOVE);
@@ -141,15 +226,16 @@ Move search(Engine& engine, Board& board, SearchParams& params, SearchStats& sta
     return bestPvLine.moves[0];
 }
 
-template Move search<WHITE>(Engine& engine, Board& board, SearchParams& params, SearchStats& stats);
-template Move search<BLACK>(Engine& engine, Board& board, SearchParams& params, SearchStats& stats);
+template Move search<WHITE>(Engine& engine, SearchThread& thread, SearchParams& params);
+template Move search<BLACK>(Engine& engine, SearchThread& thread, SearchParams& params);
 
 template <PieceColor color, NodeType nodeType>
-int pvSearch(Engine& engine, Board& board, int alpha, int beta, int depth, SearchStats& stats,
+int pvSearch(Engine& engine, Board& board, int alpha, int beta, int depth, SearchThread& thread,
              const std::chrono::time_point<std::chrono::steady_clock>& endTime, PvLine& pvLine) {
     constexpr bool isPV = nodeType == PV || nodeType == ROOT;
     constexpr bool isRoot = nodeType == ROOT;
     constexpr PieceColor opponentColor = !color;
+    SearchStats& stats = thread.stats;
 
     if (!isRoot && (stats.nodesSearched + stats.qNodesSearched) % 4096 == 0 && std::chrono::steady_clock::now() >
         endTime) {
@@ -157,6 +243,26 @@ int pvSearch(Engine& engine, Board& board, int alpha, int beta, int depth, Searc
         return beta;
     }
 
+    // If the side to move can repeat a position of this line, it can score at least a draw
+    const bool canRepeat = !isRoot && alpha < DRAW_SCORE
+                           && board.hasUpcomingRepetition(board.getPly() - thread.rootPly);
+
+    if (canRepeat) {
+        alpha = DRAW_SCORE;
+
+        if (alpha >= beta) {
+            pvLine.moveCount = 0;
+            return alpha;
+        }
+    }
+
+    int tbScore = 0;
+
+    if (!isRoot && probeTablebases(board, stats, tbScore)) {
+        pvLine.moveCount = 0;
+        return tbScore;
+    }
+
     bool isInCheck = board.isKingInCheck<color>();
 
     if (isInCheck) {
@@ -166,14 +272,18 @@ int pvSearch(Engine& engine, Board& board, int alpha, int beta, int depth, Searc
     if (depth <= 0) {
         assert(!isRoot);
         pvLine.moveCount = 0;
-        return qSearch<color, nodeType>(engine, board, alpha, beta, depth, stats, endTime);
+        return qSearch<color, nodeType>(engine, board, alpha, beta, depth, thread, endTime);
     }
 
-    stats.nodesSearched += 1;
+    stats.nodesSearched.fetch_add(1, std::memory_order_relaxed);
 
     if (!isPV) {
         // Check for a transposition table hit
-        const int16_t score = tt->probePosition(board.getZobristHash(), depth, alpha, beta, board.getPly());
+        bool ttHit = false;
+        const int16_t score = tt->probePosition(board.getZobristHash(), depth, alpha, beta, board.getPly(), ttHit);
+
+        stats.ttProbes += 1;
+        stats.ttHits += ttHit;
 
         if (score != NO_TT_SCORE) {
             return score;
@@ -185,7 +295,7 @@ int pvSearch(Engine& engine, Board& board, int alpha, int beta, int depth, Searc
             const int R = 2 + depth / 3;
             PvLine nmpPvLine = PvLine{board.getPly()};
             const int nullMoveScore = -pvSearch<opponentColor, REGULAR>(engine, board, -beta, -beta + 1, depth - R,
-                                                                        stats, endTime, nmpPvLine);
+                                                                        thread, endTime, nmpPvLine);
             board.unmakeNullMove();
 
             if (nullMoveScore >= beta) {
@@ -218,13 +328,10 @@ int pvSearch(Engine& engine, Board& board, int alpha, int beta, int depth, Searc
         const Square toSquare = getToSquare(move);
         const Piece capturedPiece = board.getPieceOnSquare(toSquare);
 
+        // Load the TT cluster of the child while the move is made
+        tt->prefetch(board.getZobristHashAfterMove(move));
         board.makeMove(move);
 
-        if (!board.isPositionLegal<color>()) {
-            board.unmakeMove();
-            continue;
-        }
-
         legalMoves += 1;
 
         if (capturedPiece == EMPTY) {
@@ -256,7 +363,7 @@ int pvSearch(Engine& engine, Board& board, int alpha, int beta, int depth, Searc
 
             R = std::max(0, R);
 
-            score = -pvSearch<opponentColor, REGULAR>(engine, board, -alpha - 1, -alpha, depth - 1 - R, stats,
+            score = -pvSearch<opponentColor, REGULAR>(engine, board, -alpha - 1, -alpha, depth - 1 - R, thread,
                                                       endTime, nodePvLine);
 
             if (score > alpha) {
@@ -267,20 +374,20 @@ int pvSearch(Engine& engine, Board& board, int alpha, int beta, int depth, Searc
         if (doFullSearch) {
             if (firstMove) {
                 if (isRoot) {
-                    score = -pvSearch<opponentColor, PV>(engine, board, -beta, -alpha, depth - 1, stats, endTime,
+                    score = -pvSearch<opponentColor, PV>(engine, board, -beta, -alpha, depth - 1, thread, endTime,
                                                          nodePvLine);
                 } else {
-                    score = -pvSearch<opponentColor, nodeType>(engine, board, -beta, -alpha, depth - 1, stats, endTime,
+                    score = -pvSearch<opponentColor, nodeType>(engine, board, -beta, -alpha, depth - 1, thread, endTime,
                                                                nodePvLine);
                 }
 
                 firstMove = false;
             } else {
-                score = -pvSearch<opponentColor, REGULAR>(engine, board, -alpha - 1, -alpha, depth - 1, stats, endTime,
+                score = -pvSearch<opponentColor, REGULAR>(engine, board, -alpha - 1, -alpha, depth - 1, thread, endTime,
                                                           nodePvLine);
 
                 if (isPV && score > alpha) {
-                    score = -pvSearch<opponentColor, PV>(engine, board, -beta, -alpha, depth - 1, stats, endTime,
+                    score = -pvSearch<opponentColor, PV>(engine, board, -beta, -alpha, depth - 1, thread, endTime,
                                                          nodePvLine);
                 }
             }
@@ -340,6 +447,10 @@ int pvSearch(Engine& engine, Board& board, int alpha, int beta, int depth, Searc
             alpha = DRAW_SCORE;
             bestScore = DRAW_SCORE;
         }
+
+        if (canRepeat) {
+            bestScore = std::max(bestScore, DRAW_SCORE);
+        }
     }
 
     if (!isRoot) {
@@ -359,34 +470,63 @@ int pvSearch(Engine& engine, Board& board, int alpha, int beta, int depth, Searc
 }
 
 template <PieceColor color, NodeType nodeType>
-int qSearch(Engine& engine, Board& board, int alpha, int beta, int depth, SearchStats& stats,
+int qSearch(Engine& engine, Board& board, int alpha, int beta, int depth, SearchThread& thread,
             const std::chrono::time_point<std::chrono::steady_clock>& endTime) {
     assert(nodeType != ROOT);
     constexpr bool isPV = nodeType == PV;
+    SearchStats& stats = thread.stats;
 
     if ((stats.nodesSearched + stats.qNodesSearched) % 4096 == 0 && std::chrono::steady_clock::now() > endTime) {
         engine.setSearchStopped(true);
         return beta;
     }
 
-    if (!isPV) {
-        const int16_t score = tt->probePosition(board.getZobristHash(), depth, alpha, beta, board.getPly());
+    int tbScore = 0;
 
-        if (score != NO_TT_SCORE) {
-            return score;
-        }
+    if (probeTablebases(board, stats, tbScore)) {
+        return tbScore;
+    }
+
+    // Also probed in PV nodes, so the stored static evaluation can be reused
+    bool ttHit = false;
+    int16_t ttStaticEval = NO_EVAL_SCORE;
+    const int16_t ttScore = tt->probePosition(board.getZobristHash(), depth, alpha, beta, board.getPly(), ttHit,
+                                              ttStaticEval);
+
+    stats.ttProbes += 1;
+    stats.ttHits += ttHit;
+
+    if (!isPV && ttScore != NO_TT_SCORE) {
+        return ttScore;
     }
 
-    stats.qNodesSearched += 1;
+    stats.qNodesSearched.fetch_add(1, std::memory_order_relaxed);
 
     const bool isInCheck = board.isKingInCheck<color>();
-    int bestScore = Evaluation(board).evaluate();
+    int staticEval = ttStaticEval;
+    // The evaluation that is stored in the transposition table. Stays empty if the evaluation stopped early.
+    int ttEval = ttStaticEval;
+
+    if (staticEval == NO_EVAL_SCORE) {
+        bool isExact = false;
+
+        // The evaluation is only used for stand pat when not in check, so only then it may stop early
+        if (isInCheck) {
+            staticEval = evaluateCached(board, thread, INITIAL_ALPHA, INITIAL_BETA, isExact);
+        } else {
+            staticEval = evaluateCached(board, thread, alpha, beta, isExact);
+        }
+
+        ttEval = isExact ? staticEval : NO_EVAL_SCORE;
+    }
+
+    int bestScore = staticEval;
 
     if (!isInCheck) {
         // Stand pat
         if (bestScore >= beta) {
             if (!engine.isSearchStopped()) {
-                tt->savePosition(board.getZobristHash(), depth, board.getPly(), bestScore, NO_MOVE, BETA);
+                tt->savePosition(board.getZobristHash(), depth, board.getPly(), bestScore, NO_MOVE, BETA, ttEval);
             }
 
             return bestScore;
@@ -423,22 +563,18 @@ int qSearch(Engine& engine, Board& board, int alpha, int beta, int depth, Search
             }
         }
 
+        tt->prefetch(board.getZobristHashAfterMove(move));
         board.makeMove(move);
 
-        if (!board.isPositionLegal<color>()) {
-            board.unmakeMove();
-            continue;
-        }
-
         legalMoves += 1;
 
-        const int score = -qSearch<!color, nodeType>(engine, board, -beta, -alpha, depth - 1, stats, endTime);
+        const int score = -qSearch<!color, nodeType>(engine, board, -beta, -alpha, depth - 1, thread, endTime);
 
         board.unmakeMove();
 
         if (score >= beta) {
             if (!engine.isSearchStopped()) {
-                tt->savePosition(board.getZobristHash(), depth, board.getPly(), score, bestMove, BETA);
+                tt->savePosition(board.getZobristHash(), depth, board.getPly(), score, bestMove, BETA, ttEval);
             }
 
             return score;
@@ -469,7 +605,7 @@ int qSearch(Engine& engine, Board& board, int alpha, int beta, int depth, Search
     }
 
     if (!engine.isSearchStopped()) {
-        tt->savePosition(board.getZobristHash(), depth, board.getPly(), bestScore, bestMove, ttNodeType);
+        tt->savePosition(board.getZobristHash(), depth, board.getPly(), bestScore, bestMove, ttNodeType, ttEval);
     }
 
     assert(bestScore != INITIAL_ALPHA);
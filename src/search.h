@@ -21,10 +21,14 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <chrono>
 #include "board.h"
+#include "eval_cache.h"
+#include "pawn_hash.h"
 #include "move.h"
+#include "nnue.h"
 #include "types.h"
 #include "uci.h"
 
@@ -45,21 +49,71 @@ struct SearchParams {
 
 struct SearchStats {
     PvLine pvLine{0};
-    uint64_t nodesSearched = 0;
-    uint64_t qNodesSearched = 0;
+    // Only written by the owning thread, but read by the main thread to report the total node count
+    std::atomic<uint64_t> nodesSearched = 0;
+    std::atomic<uint64_t> qNodesSearched = 0;
     int score = 0;
     uint16_t depth = 0;
     uint64_t timeSpentMs = 0;
+    uint64_t ttProbes = 0;
+    uint64_t ttHits = 0;
+    uint64_t evalCacheHits = 0;
+    uint64_t evalCacheMisses = 0;
+    uint64_t lazyEvals = 0;
+    uint64_t tbHits = 0;
+
+    void reset() {
+        pvLine = PvLine{0};
+        nodesSearched.store(0, std::memory_order_relaxed);
+        qNodesSearched.store(0, std::memory_order_relaxed);
+        score = 0;
+        depth = 0;
+        timeSpentMs = 0;
+        ttProbes = 0;
+        ttHits = 0;
+        evalCacheHits = 0;
+        evalCacheMisses = 0;
+        lazyEvals = 0;
+        tbHits = 0;
+    }
+};
+
+/**
+ * \brief The state of a single Lazy SMP search thread. Every thread searches the same root position on its own copy
+ * of the board, with its own evaluation cache, pawn hash table and NNUE accumulators. The transposition table is
+ * shared between all threads.
+ */
+struct alignas(64) SearchThread {
+    Board board{};
+    SearchStats stats{};
+    EvalCache evalCache{};
+    PawnHashTable pawnTable{};
+    AccumulatorStack accumulators{};
+    int id = 0;
+    // The ply of the board at the root of the search
+    int rootPly = 0;
+
+    [[nodiscard]] bool isMainThread() const {
+        return id == 0;
+    }
 };
 
 void initializeSearch();
 
+/**
+ * \brief Runs the iterative deepening search of a single search thread. The main thread reports search info and
+ * decides when to stop, helper threads search the same position until the stop flag is set.
+ * \param engine The engine.
+ * \param thread The search thread, which owns the board and statistics used by this search.
+ * \param params The search parameters.
+ * \return The best move found by this thread.
+ */
 template <PieceColor color>
-[[nodiscard]] Move search(Engine& engine, Board& board, SearchParams& params, SearchStats& stats);
+[[nodiscard]] Move search(Engine& engine, SearchThread& thread, SearchParams& params);
 
 template <PieceColor color, NodeType nodeType>
-int pvSearch(Engine& engine, Board& board, int alpha, int beta, int depth, SearchStats& stats, const std::chrono::time_point<std::chrono::steady_clock>& endTime, PvLine& pvLine);
+int pvSearch(Engine& engine, Board& board, int alpha, int beta, int depth, SearchThread& thread, const std::chrono::time_point<std::chrono::steady_clock>& endTime, PvLine& pvLine);
 
 template <PieceColor color, NodeType nodeType>
-[[nodiscard]] int qSearch(Engine& engine, Board& board, int alpha, int beta, int depth, SearchStats& stats, const std::chrono::time_point<std::chrono::steady_clock>& endTime);
+[[nodiscard]] int qSearch(Engine& engine, Board& board, int alpha, int beta, int depth, SearchThread& thread, const std::chrono::time_point<std::chrono::steady_clock>& endTime);
 } // namespace Zagreus
@@ -0,0 +1,842 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "tablebase.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include "bitboard.h"
+#include "board.h"
+
+namespace Zagreus {
+// The generation state of a position: the amount of moves into the same table that are not known to lose yet, the
+// status and whether a move into another table draws
+constexpr uint16_t STATE_COUNT_MASK = 0xFF;
+constexpr int STATE_STATUS_SHIFT = 8;
+constexpr uint16_t STATE_HAS_DRAW = 1 << 11;
+
+enum GenerationStatus : uint16_t {
+    STATUS_UNKNOWN,
+    STATUS_WIN,
+    STATUS_LOSS,
+    STATUS_DRAW,
+    STATUS_INVALID
+};
+
+// The pieces of a name in strength order, kings excluded
+constexpr std::string_view TB_PIECE_LETTERS = "QRBNP";
+constexpr PieceType TB_PIECE_TYPES[] = {QUEEN, ROOK, BISHOP, KNIGHT, PAWN};
+
+/**
+ * \brief A position of a table, with the squares in the order of the pieces of the table.
+ */
+struct TBPosition {
+    std::array<uint8_t, TB_MAX_PIECES> squares{};
+    PieceColor sideToMove = WHITE;
+};
+
+static GenerationStatus getStatus(const uint16_t state) {
+    return static_cast<GenerationStatus>((state >> STATE_STATUS_SHIFT) & 0x7);
+}
+
+static uint16_t makeState(const GenerationStatus status, const int count = 0, const bool hasDraw = false) {
+    return static_cast<uint16_t>(count | status << STATE_STATUS_SHIFT | (hasDraw ? STATE_HAS_DRAW : 0));
+}
+
+static uint64_t getEntryCount(const int pieceCount) {
+    uint64_t entryCount = COLORS * 32;
+
+    for (int i = 1; i < pieceCount; i++) {
+        entryCount *= SQUARES;
+    }
+
+    return entryCount;
+}
+
+/**
+ * \brief Gets the key of a material combination, which has a base 3 digit with the count of every piece but the kings.
+ */
+static uint32_t getMaterialKey(const Piece* pieces, const int pieceCount, const bool swapColors) {
+    static constexpr uint32_t powers[] = {1, 3, 9, 27, 81, 243, 729, 2187, 6561, 19683};
+    uint32_t key = 0;
+
+    for (int i = 0; i < pieceCount; i++) {
+        if (getPieceType(pieces[i]) != KING) {
+            key += powers[swapColors ? pieces[i] ^ 1 : pieces[i]];
+        }
+    }
+
+    return key;
+}
+
+static uint64_t encodeIndex(const WDLTable& table, const TBPosition& position) {
+    // Mirror the board so the white king is on the a-d files
+    const uint8_t mirror = (position.squares[0] & 7) >= 4 ? 7 : 0;
+    const uint8_t whiteKingSquare = position.squares[0] ^ mirror;
+    uint64_t index = position.sideToMove * 32 + (whiteKingSquare >> 3) * 4 + (whiteKingSquare & 7);
+
+    for (int i = 1; i < table.pieceCount; i++) {
+        index = index * SQUARES + (position.squares[i] ^ mirror);
+    }
+
+    return index;
+}
+
+static TBPosition decodeIndex(const WDLTable& table, uint64_t index) {
+    TBPosition position{};
+
+    for (int i = table.pieceCount - 1; i >= 1; i--) {
+        position.squares[i] = static_cast<uint8_t>(index % SQUARES);
+        index /= SQUARES;
+    }
+
+    const uint64_t whiteKingIndex = index % 32;
+
+    position.squares[0] = static_cast<uint8_t>((whiteKingIndex / 4) * 8 + whiteKingIndex % 4);
+    position.sideToMove = static_cast<PieceColor>(index / 32);
+    return position;
+}
+
+static uint64_t getAttacks(const Piece piece, const uint8_t square, const uint64_t occupied) {
+    switch (getPieceType(piece)) {
+        case PAWN:
+            return getPieceColor(piece) == WHITE ? getPawnAttacks<WHITE>(square) : getPawnAttacks<BLACK>(square);
+        case KNIGHT:
+            return getKnightAttacks(square);
+        case BISHOP:
+            return getBishopAttacks(square, occupied);
+        case ROOK:
+            return getRookAttacks(square, occupied);
+        case QUEEN:
+            return queenAttacks(square, occupied);
+        case KING:
+            return getKingAttacks(square);
+    }
+
+    return 0;
+}
+
+static bool isKingAttacked(const Piece* pieces, const uint8_t* squares, const int pieceCount, const PieceColor color) {
+    const Piece king = getPieceFromType(KING, color);
+    uint64_t occupied = 0;
+    uint64_t kingBB = 0;
+
+    for (int i = 0; i < pieceCount; i++) {
+        occupied |= squareToBitboard(squares[i]);
+
+        if (pieces[i] == king) {
+            kingBB = squareToBitboard(squares[i]);
+        }
+    }
+
+    for (int i = 0; i < pieceCount; i++) {
+        if (getPieceColor(pieces[i]) != color && (getAttacks(pieces[i], squares[i], occupied) & kingBB)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool isLastRank(const uint8_t square) {
+    return square < 8 || square >= 56;
+}
+
+static bool isValidPosition(const WDLTable& table, const TBPosition& position) {
+    uint64_t occupied = 0;
+
+    for (int i = 0; i < table.pieceCount; i++) {
+        const uint64_t squareBB = squareToBitboard(position.squares[i]);
+
+        if ((occupied & squareBB) || (getPieceType(table.pieces[i]) == PAWN && isLastRank(position.squares[i]))) {
+            return false;
+        }
+
+        occupied |= squareBB;
+    }
+
+    // The side that just moved can't be in check
+    return !isKingAttacked(table.pieces.data(), position.squares.data(), table.pieceCount, !position.sideToMove);
+}
+
+/**
+ * \brief Gets the result of answering a double pawn push with an en passant capture. The tables have no en passant
+ * square, so this decides how the push has to be scored.
+ * \param position The position after the double push, with the capturing side to move.
+ * \param pushedSlot The slot of the pawn that was pushed.
+ * \param[out] result The result of the best en passant capture for the capturing side, from the perspective of the
+ * side that pushed. TB_INVALID if the table of a capture is not loaded.
+ * \return True if the push can be captured en passant, false otherwise.
+ */
+static bool getEnPassantResult(const Tablebases& tablebases, const WDLTable& table, const TBPosition& position,
+                               const int pushedSlot, TBResult& result) {
+    const PieceColor capturer = position.sideToMove;
+    const Piece capturingPawn = getPieceFromType(PAWN, capturer);
+    const uint8_t pushedSquare = position.squares[pushedSlot];
+    const uint8_t captureSquare = capturer == WHITE ? pushedSquare + 8 : pushedSquare - 8;
+    bool canCapture = false;
+
+    result = TB_WIN;
+
+    for (int i = 0; i < table.pieceCount; i++) {
+        const uint8_t square = position.squares[i];
+
+        if (table.pieces[i] != capturingPawn || square / 8 != pushedSquare / 8
+            || std::abs(square % 8 - pushedSquare % 8) != 1) {
+            continue;
+        }
+
+        std::array<Piece, TB_MAX_PIECES> childPieces = table.pieces;
+        std::array<uint8_t, TB_MAX_PIECES> childSquares = position.squares;
+        int childCount = table.pieceCount;
+
+        childSquares[i] = captureSquare;
+        childPieces[pushedSlot] = childPieces[childCount - 1];
+        childSquares[pushedSlot] = childSquares[childCount - 1];
+        childCount -= 1;
+
+        if (isKingAttacked(childPieces.data(), childSquares.data(), childCount, capturer)) {
+            continue;
+        }
+
+        const TBResult captureResult = tablebases.lookup(childPieces.data(), childSquares.data(), childCount,
+                                                         !capturer);
+
+        canCapture = true;
+
+        if (captureResult == TB_INVALID || captureResult == TB_LOSS) {
+            result = captureResult;
+            break;
+        }
+
+        if (captureResult == TB_DRAW) {
+            result = TB_DRAW;
+        }
+    }
+
+    return canCapture;
+}
+
+/**
+ * \brief Generates the legal moves of a position of a table. Calls onTableMove with the index of every position in the
+ * same table, and onOtherMove with the result of every position after a capture or promotion.
+ *
+ * A double push that can be captured en passant leads to a position that is not in the table. If the capture wins for
+ * the opponent, the push is passed to onOtherMove as a loss. If the capture draws, the push is passed to onTableMove
+ * with isDrawCapped set: it draws, unless the opponent wins the position without the en passant square.
+ * \return The amount of legal moves.
+ */
+template <typename TableMoveCallback, typename OtherMoveCallback>
+static int generateChildren(const Tablebases& tablebases, const WDLTable& table, const TBPosition& position,
+                            TableMoveCallback&& onTableMove, OtherMoveCallback&& onOtherMove) {
+    const PieceColor sideToMove = position.sideToMove;
+    uint64_t occupied = 0;
+    uint64_t ownPieces = 0;
+    int legalMoves = 0;
+
+    for (int i = 0; i < table.pieceCount; i++) {
+        occupied |= squareToBitboard(position.squares[i]);
+
+        if (getPieceColor(table.pieces[i]) == sideToMove) {
+            ownPieces |= squareToBitboard(position.squares[i]);
+        }
+    }
+
+    for (int i = 0; i < table.pieceCount; i++) {
+        const Piece piece = table.pieces[i];
+
+        if (getPieceColor(piece) != sideToMove) {
+            continue;
+        }
+
+        const uint8_t fromSquare = position.squares[i];
+        uint64_t targets;
+
+        if (getPieceType(piece) == PAWN) {
+            const int direction = sideToMove == WHITE ? 8 : -8;
+            const int startRank = sideToMove == WHITE ? 1 : 6;
+            const uint8_t pushSquare = fromSquare + direction;
+
+            targets = getAttacks(piece, fromSquare, occupied) & occupied & ~ownPieces;
+
+            if (!(occupied & squareToBitboard(pushSquare))) {
+                targets |= squareToBitboard(pushSquare);
+
+                if (fromSquare / 8 == startRank && !(occupied & squareToBitboard(pushSquare + direction))) {
+                    targets |= squareToBitboard(pushSquare + direction);
+                }
+            }
+        } else {
+            targets = getAttacks(piece, fromSquare, occupied) & ~ownPieces;
+        }
+
+        while (targets) {
+            const uint8_t toSquare = popLsb(targets);
+            std::array<Piece, TB_MAX_PIECES> childPieces = table.pieces;
+            std::array<uint8_t, TB_MAX_PIECES> childSquares = position.squares;
+            int childCount = table.pieceCount;
+            int movedSlot = i;
+            bool isCapture = false;
+
+            childSquares[i] = toSquare;
+
+            for (int j = 0; j < table.pieceCount; j++) {
+                if (j != i && position.squares[j] == toSquare) {
+                    // Kings are never captured, so the kings stay in the first two slots
+                    childPieces[j] = childPieces[childCount - 1];
+                    childSquares[j] = childSquares[childCount - 1];
+                    movedSlot = movedSlot == childCount - 1 ? j : movedSlot;
+                    childCount -= 1;
+                    isCapture = true;
+                    break;
+                }
+            }
+
+            if (isKingAttacked(childPieces.data(), childSquares.data(), childCount, sideToMove)) {
+                continue;
+            }
+
+            legalMoves += 1;
+
+            if (getPieceType(piece) == PAWN && isLastRank(toSquare)) {
+                for (const PieceType promotionType : {QUEEN, ROOK, BISHOP, KNIGHT}) {
+                    childPieces[movedSlot] = getPieceFromType(promotionType, sideToMove);
+                    onOtherMove(tablebases.lookup(childPieces.data(), childSquares.data(), childCount, !sideToMove));
+                }
+
+                // The other promotions are legal moves as well
+                legalMoves += 3;
+            } else if (isCapture) {
+                onOtherMove(tablebases.lookup(childPieces.data(), childSquares.data(), childCount, !sideToMove));
+            } else {
+                const TBPosition child{childSquares, !sideToMove};
+                const bool isDoublePush = getPieceType(piece) == PAWN && std::abs(toSquare - fromSquare) == 16;
+                TBResult enPassantResult = TB_WIN;
+
+                if (isDoublePush) {
+                    getEnPassantResult(tablebases, table, child, i, enPassantResult);
+                }
+
+                if (enPassantResult == TB_INVALID) {
+                    onOtherMove(TB_INVALID);
+                } else if (enPassantResult == TB_LOSS) {
+                    onOtherMove(TB_WIN);
+                } else {
+                    onTableMove(encodeIndex(table, child), enPassantResult == TB_DRAW);
+                }
+            }
+        }
+    }
+
+    return legalMoves;
+}
+
+/**
+ * \brief Generates the positions of a table from which the side that just moved could have reached the given position
+ * with a move that stays in the table, so no capture or promotion. Double pushes are scored like generateChildren does:
+ * a push that loses to an en passant capture is skipped, and one that draws by it is passed with isDrawCapped set.
+ */
+template <typename Callback>
+static void generatePredecessors(const Tablebases& tablebases, const WDLTable& table, const TBPosition& position,
+                                 Callback&& callback) {
+    const PieceColor mover = !position.sideToMove;
+    uint64_t occupied = 0;
+
+    for (int i = 0; i < table.pieceCount; i++) {
+        occupied |= squareToBitboard(position.squares[i]);
+    }
+
+    for (int i = 0; i < table.pieceCount; i++) {
+        const Piece piece = table.pieces[i];
+
+        if (getPieceColor(piece) != mover) {
+            continue;
+        }
+
+        const uint8_t toSquare = position.squares[i];
+        uint64_t fromSquares = 0;
+
+        if (getPieceType(piece) == PAWN) {
+            const int direction = mover == WHITE ? -8 : 8;
+            const int doublePushRank = mover == WHITE ? 3 : 4;
+            const int pushSquare = toSquare + direction;
+
+            if (!isLastRank(pushSquare) && !(occupied & squareToBitboard(pushSquare))) {
+                fromSquares |= squareToBitboard(pushSquare);
+
+                if (toSquare / 8 == doublePushRank && !(occupied & squareToBitboard(pushSquare + direction))) {
+                    fromSquares |= squareToBitboard(pushSquare + direction);
+                }
+            }
+        } else {
+            fromSquares = getAttacks(piece, toSquare, occupied) & ~occupied;
+        }
+
+        while (fromSquares) {
+            TBPosition predecessor{position.squares, mover};
+            TBResult enPassantResult = TB_WIN;
+
+            predecessor.squares[i] = popLsb(fromSquares);
+
+            if (getPieceType(piece) == PAWN && std::abs(toSquare - predecessor.squares[i]) == 16) {
+                getEnPassantResult(tablebases, table, position, i, enPassantResult);
+            }
+
+            // The side to move of the given position can't be in check while the other side is to move
+            if (enPassantResult != TB_LOSS && !isKingAttacked(table.pieces.data(), predecessor.squares.data(),
+                                                              table.pieceCount, position.sideToMove)) {
+                callback(encodeIndex(table, predecessor), enPassantResult == TB_DRAW);
+            }
+        }
+    }
+}
+
+/**
+ * \brief Splits a range over threads and waits for all of them to finish.
+ */
+template <typename Function>
+static void runParallel(const int threadCount, const uint64_t count, Function&& function) {
+    std::vector<std::thread> threads{};
+    const uint64_t chunkSize = (count + threadCount - 1) / threadCount;
+
+    for (int threadId = 0; threadId < threadCount; threadId++) {
+        const uint64_t begin = threadId * chunkSize;
+        const uint64_t end = std::min(count, begin + chunkSize);
+
+        if (begin >= end) {
+            break;
+        }
+
+        threads.emplace_back([&function, begin, end, threadId] { function(begin, end, threadId); });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+/**
+ * \brief Creates an empty table from its name, for example "KRvKP".
+ * \return The table, or nullptr if the name is not a valid table name.
+ */
+static std::unique_ptr<WDLTable> createTable(const std::string& name) {
+    const size_t separator = name.find('v');
+
+    if (separator == std::string::npos || name.size() > TB_MAX_PIECES + 1 || name[0] != 'K'
+        || name[separator + 1] != 'K') {
+        return nullptr;
+    }
+
+    auto table = std::make_unique<WDLTable>();
+
+    table->name = name;
+    table->pieces[0] = WHITE_KING;
+    table->pieces[1] = BLACK_KING;
+    table->pieceCount = 2;
+
+    for (size_t i = 1; i < name.size(); i++) {
+        if (i == separator || i == separator + 1) {
+            continue;
+        }
+
+        const size_t letterIndex = TB_PIECE_LETTERS.find(name[i]);
+
+        if (letterIndex == std::string_view::npos) {
+            return nullptr;
+        }
+
+        const PieceColor color = i < separator ? WHITE : BLACK;
+        table->pieces[table->pieceCount++] = getPieceFromType(TB_PIECE_TYPES[letterIndex], color);
+    }
+
+    table->entryCount = getEntryCount(table->pieceCount);
+    return table;
+}
+
+void Tablebases::addTable(std::unique_ptr<WDLTable> table) {
+    maxPieces = std::max(maxPieces, table->pieceCount);
+    tables[getMaterialKey(table->pieces.data(), table->pieceCount, false)] = std::move(table);
+}
+
+TBResult Tablebases::lookup(const Piece* pieces, const uint8_t* squares, const int pieceCount,
+                            const PieceColor sideToMove) const {
+    if (pieceCount == 2) {
+        return TB_DRAW;
+    }
+
+    bool swapColors = false;
+    auto iterator = tables.find(getMaterialKey(pieces, pieceCount, false));
+
+    if (iterator == tables.end()) {
+        swapColors = true;
+        iterator = tables.find(getMaterialKey(pieces, pieceCount, true));
+
+        if (iterator == tables.end()) {
+            return TB_INVALID;
+        }
+    }
+
+    // With swapped colors, the board is flipped so the pawns still move the right way
+    const WDLTable& table = *iterator->second;
+    TBPosition position{{}, swapColors ? !sideToMove : sideToMove};
+    bool used[TB_MAX_PIECES]{};
+
+    for (int slot = 0; slot < table.pieceCount; slot++) {
+        const Piece wanted = swapColors ? static_cast<Piece>(table.pieces[slot] ^ 1) : table.pieces[slot];
+
+        for (int i = 0; i < pieceCount; i++) {
+            if (!used[i] && pieces[i] == wanted) {
+                used[i] = true;
+                position.squares[slot] = swapColors ? squares[i] ^ 56 : squares[i];
+                break;
+            }
+        }
+    }
+
+    return table.getResult(encodeIndex(table, position));
+}
+
+bool Tablebases::probe(const Board& board, TBResult& result) const {
+    uint64_t occupied = board.getOccupiedBitboard();
+
+    if (tables.empty() || !canProbe(occupied) || board.getCastlingRights() != 0 || board.getEnPassantSquare() != 255) {
+        return false;
+    }
+
+    Piece pieces[TB_MAX_PIECES];
+    uint8_t squares[TB_MAX_PIECES];
+    int pieceCount = 0;
+
+    while (occupied) {
+        const uint8_t square = popLsb(occupied);
+
+        pieces[pieceCount] = board.getPieceOnSquare(square);
+        squares[pieceCount] = square;
+        pieceCount += 1;
+    }
+
+    result = lookup(pieces, squares, pieceCount, board.getSideToMove());
+    return result != TB_INVALID;
+}
+
+std::unique_ptr<WDLTable> Tablebases::generateTable(const std::string& name, const int threadCount) const {
+    std::unique_ptr<WDLTable> table = createTable(name);
+
+    if (!table) {
+        return nullptr;
+    }
+
+    const uint64_t entryCount = table->entryCount;
+    std::vector<std::atomic<uint16_t>> states(entryCount);
+    std::vector<std::vector<uint32_t>> threadFrontiers(threadCount);
+    std::atomic<bool> missingTable = false;
+
+    // Decide every position that is mate, stalemate or decided by a capture or promotion, and count the other moves
+    runParallel(threadCount, entryCount, [&](const uint64_t begin, const uint64_t end, const int threadId) {
+        for (uint64_t index = begin; index < end; index++) {
+            const TBPosition position = decodeIndex(*table, index);
+
+            if (!isValidPosition(*table, position)) {
+                states[index].store(makeState(STATUS_INVALID), std::memory_order_relaxed);
+                continue;
+            }
+
+            int tableMoves = 0;
+            bool hasWin = false;
+            bool hasDraw = false;
+            const int legalMoves = generateChildren(
+                *this, *table, position, [&tableMoves](uint64_t, bool) { tableMoves += 1; },
+                [&](const TBResult childResult) {
+                    hasWin |= childResult == TB_LOSS;
+                    hasDraw |= childResult == TB_DRAW;
+
+                    if (childResult == TB_INVALID) {
+                        missingTable = true;
+                    }
+                });
+            uint16_t state;
+
+            if (hasWin) {
+                state = makeState(STATUS_WIN);
+            } else if (legalMoves == 0) {
+                const bool isInCheck = isKingAttacked(table->pieces.data(), position.squares.data(), table->pieceCount,
+                                                      position.sideToMove);
+                state = makeState(isInCheck ? STATUS_LOSS : STATUS_DRAW);
+            } else if (tableMoves == 0) {
+                state = makeState(hasDraw ? STATUS_DRAW : STATUS_LOSS);
+            } else {
+                state = makeState(STATUS_UNKNOWN, tableMoves, hasDraw);
+            }
+
+            states[index].store(state, std::memory_order_relaxed);
+
+            if (getStatus(state) == STATUS_WIN || getStatus(state) == STATUS_LOSS) {
+                threadFrontiers[threadId].push_back(static_cast<uint32_t>(index));
+            }
+        }
+    });
+
+    if (missingTable) {
+        return nullptr;
+    }
+
+    std::vector<uint32_t> frontier{};
+
+    // Propagate the decided positions back to their predecessors, one ply at a time
+    while (true) {
+        frontier.clear();
+
+        for (std::vector<uint32_t>& threadFrontier : threadFrontiers) {
+            frontier.insert(frontier.end(), threadFrontier.begin(), threadFrontier.end());
+            threadFrontier.clear();
+        }
+
+        if (frontier.empty()) {
+            break;
+        }
+
+        runParallel(threadCount, frontier.size(), [&](const uint64_t begin, const uint64_t end, const int threadId) {
+            for (uint64_t i = begin; i < end; i++) {
+                const uint32_t index = frontier[i];
+                const bool isLoss = getStatus(states[index].load(std::memory_order_relaxed)) == STATUS_LOSS;
+
+                const auto onPredecessor = [&](const uint64_t predecessor, const bool isDrawCapped) {
+                    std::atomic<uint16_t>& predecessorState = states[predecessor];
+                    uint16_t state = predecessorState.load(std::memory_order_relaxed);
+                    // A move to a lost position wins, unless the opponent can draw with an en passant capture
+                    const bool isWinningMove = isLoss && !isDrawCapped;
+                    const uint16_t drawFlag = isLoss ? STATE_HAS_DRAW : 0;
+
+                    while (getStatus(state) == STATUS_UNKNOWN) {
+                        uint16_t newState;
+
+                        if (isWinningMove) {
+                            newState = makeState(STATUS_WIN);
+                        } else if ((state & STATE_COUNT_MASK) == 1) {
+                            // The last move that was not known to lose
+                            newState = makeState(((state | drawFlag) & STATE_HAS_DRAW) ? STATUS_DRAW : STATUS_LOSS);
+                        } else {
+                            newState = (state - 1) | drawFlag;
+                        }
+
+                        if (predecessorState.compare_exchange_weak(state, newState, std::memory_order_relaxed)) {
+                            if (getStatus(newState) == STATUS_WIN || getStatus(newState) == STATUS_LOSS) {
+                                threadFrontiers[threadId].push_back(static_cast<uint32_t>(predecessor));
+                            }
+
+                            break;
+                        }
+                    }
+                };
+
+                generatePredecessors(*this, *table, decodeIndex(*table, index), onPredecessor);
+            }
+        });
+    }
+
+    // Every position that can't be forced to a win or a loss is a draw
+    table->data.assign((entryCount + 3) / 4, 0);
+
+    for (uint64_t index = 0; index < entryCount; index++) {
+        TBResult result = TB_DRAW;
+
+        switch (getStatus(states[index].load(std::memory_order_relaxed))) {
+            case STATUS_WIN:
+                result = TB_WIN;
+                break;
+            case STATUS_LOSS:
+                result = TB_LOSS;
+                break;
+            case STATUS_INVALID:
+                result = TB_INVALID;
+                break;
+            default:
+                break;
+        }
+
+        table->data[index >> 2] |= static_cast<uint8_t>(result << ((index & 3) * 2));
+    }
+
+    return table;
+}
+
+std::vector<std::string> Tablebases::getTableNames(const int pieceCount) {
+    // Every combination of up to two pieces besides a king, strongest first
+    std::vector<std::string> sides{""};
+
+    for (size_t first = 0; first < TB_PIECE_LETTERS.size(); first++) {
+        sides.emplace_back(1, TB_PIECE_LETTERS[first]);
+
+        for (size_t second = first; second < TB_PIECE_LETTERS.size(); second++) {
+            sides.push_back(std::string{TB_PIECE_LETTERS[first], TB_PIECE_LETTERS[second]});
+        }
+    }
+
+    // A side is stronger with more pieces, or with stronger pieces
+    const auto isStronger = [](const std::string& side, const std::string& otherSide) {
+        if (side.size() != otherSide.size()) {
+            return side.size() > otherSide.size();
+        }
+
+        for (size_t i = 0; i < side.size(); i++) {
+            if (side[i] != otherSide[i]) {
+                return TB_PIECE_LETTERS.find(side[i]) < TB_PIECE_LETTERS.find(otherSide[i]);
+            }
+        }
+
+        return false;
+    };
+
+    std::vector<std::string> names{};
+
+    for (const std::string& whiteSide : sides) {
+        for (const std::string& blackSide : sides) {
+            const int count = static_cast<int>(2 + whiteSide.size() + blackSide.size());
+
+            // The colors of the weaker side are swapped when probing, a draw with only kings needs no table
+            if (count > std::min(pieceCount, TB_MAX_PIECES) || count == 2 || isStronger(blackSide, whiteSide)) {
+                continue;
+            }
+
+            names.push_back("K" + whiteSide + "vK" + blackSide);
+        }
+    }
+
+    // Captures lead to fewer pieces and promotions to fewer pawns, so those tables are generated first
+    std::ranges::stable_sort(names, [](const std::string& name, const std::string& otherName) {
+        return std::make_pair(name.size(), std::ranges::count(name, 'P'))
+               < std::make_pair(otherName.size(), std::ranges::count(otherName, 'P'));
+    });
+
+    return names;
+}
+
+int Tablebases::loadTables(const std::string& directory) {
+    std::error_code error{};
+    int loadedTables = 0;
+
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (entry.path().extension() != ".zwdl") {
+            continue;
+        }
+
+        std::unique_ptr<WDLTable> table = createTable(entry.path().stem().string());
+        std::ifstream file(entry.path(), std::ios::binary);
+        TBFileHeader header{};
+        const TBFileHeader expectedHeader{};
+
+        if (!table || !file || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+            continue;
+        }
+
+        if (std::memcmp(header.magic, expectedHeader.magic, sizeof(header.magic)) != 0
+            || header.version != TB_FILE_VERSION || header.pieceCount != static_cast<uint32_t>(table->pieceCount)
+            || header.entryCount != table->entryCount) {
+            continue;
+        }
+
+        table->data.resize((table->entryCount + 3) / 4);
+
+        if (!file.read(reinterpret_cast<char*>(table->data.data()), static_cast<std::streamsize>(table->data.size()))) {
+            continue;
+        }
+
+        addTable(std::move(table));
+        loadedTables += 1;
+    }
+
+    return loadedTables;
+}
+
+bool Tablebases::generateTables(const std::string& directory, const int pieceCount, const int threadCount,
+                                const std::function<void(const std::string&, uint64_t)>& onTableGenerated) {
+    return generateTables(directory, getTableNames(pieceCount), threadCount, onTableGenerated);
+}
+
+bool Tablebases::generateTables(const std::string& directory, const std::vector<std::string>& names,
+                                const int threadCount,
+                                const std::function<void(const std::string&, uint64_t)>& onTableGenerated) {
+    std::error_code error{};
+
+    std::filesystem::create_directories(directory, error);
+
+    if (error) {
+        return false;
+    }
+
+    for (const std::string& name : names) {
+        std::unique_ptr<WDLTable> existingTable = createTable(name);
+
+        if (!existingTable) {
+            return false;
+        }
+
+        if (tables.contains(getMaterialKey(existingTable->pieces.data(), existingTable->pieceCount, false))) {
+            continue;
+        }
+
+        const auto startTime = std::chrono::steady_clock::now();
+        std::unique_ptr<WDLTable> table = generateTable(name, std::max(1, threadCount));
+
+        if (!table) {
+            return false;
+        }
+
+        TBFileHeader header{};
+        const std::filesystem::path path = std::filesystem::path(directory) / (name + ".zwdl");
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+        header.pieceCount = table->pieceCount;
+        header.entryCount = table->entryCount;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(table->data.data()), static_cast<std::streamsize>(table->data.size()));
+
+        if (!file) {
+            return false;
+        }
+
+        addTable(std::move(table));
+
+        if (onTableGenerated) {
+            const auto duration = std::chrono::steady_clock::now() - startTime;
+            onTableGenerated(name, std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+        }
+    }
+
+    return true;
+}
+
+void Tablebases::clear() {
+    tables.clear();
+    maxPieces = 0;
+}
+
+Tablebases* Tablebases::getTablebases() {
+    static Tablebases instance{};
+    return &instance;
+}
+} // namespace Zagreus
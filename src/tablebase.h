@@ -0,0 +1,170 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bitwise.h"
+#include "constants.h"
+#include "types.h"
+
+namespace Zagreus {
+class Board;
+
+constexpr int TB_MAX_PIECES = 4;
+constexpr uint32_t TB_FILE_VERSION = 1;
+// Tablebase wins score below every mate score
+constexpr int TB_WIN_SCORE = MATE_SCORE - 2 * MAX_PLIES;
+
+/**
+ * \brief The result of a position for the side to move. The values are stored with 2 bits per position.
+ */
+enum TBResult : uint8_t {
+    TB_DRAW,
+    TB_WIN,
+    TB_LOSS,
+    TB_INVALID
+};
+
+/**
+ * \brief The header of a cached table file. The file name is the name of the table.
+ */
+struct TBFileHeader {
+    char magic[8]{'Z', 'A', 'G', 'R', 'E', 'W', 'D', 'L'};
+    uint32_t version = TB_FILE_VERSION;
+    uint32_t pieceCount = 0;
+    uint64_t entryCount = 0;
+};
+
+/**
+ * \brief The win/draw/loss results of every position of one material combination. The white king is mirrored to the
+ * a-d files, the index is made of the side to move, the white king, the black king and the other pieces in the order
+ * of the name of the table (white pieces first, strongest first).
+ */
+struct WDLTable {
+    std::string name{};
+    std::array<Piece, TB_MAX_PIECES> pieces{};
+    int pieceCount = 0;
+    uint64_t entryCount = 0;
+    std::vector<uint8_t> data{};
+
+    [[nodiscard]] TBResult getResult(const uint64_t index) const {
+        return static_cast<TBResult>((data[index >> 2] >> ((index & 3) * 2)) & 3);
+    }
+};
+
+/**
+ * \brief Win/draw/loss tablebases for positions with up to 4 pieces, generated by the engine itself with retrograde
+ * analysis. Generated tables are cached in a directory. Positions with castling rights or an en passant square are
+ * not in the tables, but the generation does score a double push by the en passant capture that can answer it. The
+ * 50-move rule is ignored.
+ */
+class Tablebases {
+private:
+    std::unordered_map<uint32_t, std::unique_ptr<WDLTable>> tables{};
+    int maxPieces = 0;
+
+    void addTable(std::unique_ptr<WDLTable> table);
+
+    [[nodiscard]] std::unique_ptr<WDLTable> generateTable(const std::string& name, int threadCount) const;
+
+public:
+    /**
+     * \brief Looks up a position given as a list of pieces. The pieces can be in any order, but the kings have to be on
+     * the board.
+     * \param pieces The pieces on the board.
+     * \param squares The square of every piece.
+     * \param pieceCount The amount of pieces.
+     * \param sideToMove The side to move.
+     * \return The result for the side to move, or TB_INVALID if there is no table for the material.
+     */
+    [[nodiscard]] TBResult lookup(const Piece* pieces, const uint8_t* squares, int pieceCount,
+                                  PieceColor sideToMove) const;
+
+    /**
+     * \brief Looks up the current position of a board.
+     * \param board The board.
+     * \param result Set to the result for the side to move if the position was found.
+     * \return True if the position is in a loaded table, false otherwise.
+     */
+    [[nodiscard]] bool probe(const Board& board, TBResult& result) const;
+
+    /**
+     * \brief Checks if a position could be in the loaded tables, without looking it up.
+     */
+    [[nodiscard]] bool canProbe(const uint64_t occupied) const {
+        return popcnt(occupied) <= static_cast<uint64_t>(maxPieces);
+    }
+
+    /**
+     * \brief Loads every table of up to TB_MAX_PIECES pieces that is cached in a directory.
+     * \param directory The directory with the table files.
+     * \return The amount of tables that were loaded.
+     */
+    int loadTables(const std::string& directory);
+
+    /**
+     * \brief Generates every table of up to the given amount of pieces that is not loaded yet, smallest first, and
+     * saves them to a directory.
+     * \param directory The directory to save the tables to. Created if it does not exist.
+     * \param pieceCount The maximum amount of pieces, including the kings. At most TB_MAX_PIECES.
+     * \param threadCount The amount of threads used to generate a table.
+     * \param onTableGenerated Called with the name of every generated table and the time it took in milliseconds.
+     * \return True if all tables were generated and saved, false otherwise.
+     */
+    bool generateTables(const std::string& directory, int pieceCount, int threadCount,
+                        const std::function<void(const std::string&, uint64_t)>& onTableGenerated = {});
+
+    /**
+     * \brief Generates the given tables that are not loaded yet, in the given order, and saves them to a directory. The
+     * tables that captures and promotions lead to have to be loaded or come earlier in the list.
+     * \param directory The directory to save the tables to. Created if it does not exist.
+     * \param names The names of the tables, for example "KPvKP".
+     * \param threadCount The amount of threads used to generate a table.
+     * \param onTableGenerated Called with the name of every generated table and the time it took in milliseconds.
+     * \return True if all tables were generated and saved, false otherwise.
+     */
+    bool generateTables(const std::string& directory, const std::vector<std::string>& names, int threadCount,
+                        const std::function<void(const std::string&, uint64_t)>& onTableGenerated = {});
+
+    /**
+     * \brief Unloads all tables.
+     */
+    void clear();
+
+    /**
+     * \brief Gets the names of all tables of up to the given amount of pieces, in the order they have to be generated.
+     */
+    [[nodiscard]] static std::vector<std::string> getTableNames(int pieceCount);
+
+    [[nodiscard]] int getTableCount() const {
+        return static_cast<int>(tables.size());
+    }
+
+    static Tablebases* getTablebases();
+};
+} // namespace Zagreus
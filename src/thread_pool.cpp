@@ -0,0 +1,224 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include "search.h"
+#include "tt.h"
+#include "types.h"
+#include "uci.h"
+
+namespace Zagreus {
+ThreadPool::~ThreadPool() {
+    engine.setSearchStopped(true);
+    joinWorkers();
+}
+
+void ThreadPool::resize(const int threadCount) {
+    waitForSearchFinished();
+    joinWorkers();
+    searchThreads.clear();
+
+    for (int i = 0; i < std::max(threadCount, 1); ++i) {
+        std::unique_ptr<SearchThread>& searchThread = searchThreads.emplace_back(std::make_unique<SearchThread>());
+
+        searchThread->id = i;
+        searchThread->evalCache.resize(evalCacheSize);
+    }
+
+    exiting = false;
+
+    for (int i = 0; i < static_cast<int>(searchThreads.size()); ++i) {
+        workers.emplace_back(&ThreadPool::idleLoop, this, i, searchGeneration);
+    }
+}
+
+void ThreadPool::setEvalCacheSize(const int megaBytes) {
+    waitForSearchFinished();
+    evalCacheSize = megaBytes;
+
+    for (const std::unique_ptr<SearchThread>& searchThread : searchThreads) {
+        searchThread->evalCache.resize(megaBytes);
+    }
+}
+
+void ThreadPool::setUseNNUE(const bool enabled) {
+    waitForSearchFinished();
+    useNNUE = enabled;
+
+    // The cached evaluations come from the other evaluation, both in the eval caches and in the TT
+    for (const std::unique_ptr<SearchThread>& searchThread : searchThreads) {
+        searchThread->evalCache.clear();
+    }
+
+    TranspositionTable::getTT()->clearStaticEvals();
+}
+
+void ThreadPool::joinWorkers() {
+    {
+        std::lock_guard lock(mutex);
+        exiting = true;
+    }
+
+    startCondition.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    workers.clear();
+}
+
+void ThreadPool::startSearch(const Board& board, const SearchParams& searchParams, const bool reportBestMove) {
+    waitForSearchFinished();
+
+    if (workers.empty()) {
+        resize(1);
+    }
+
+    {
+        std::lock_guard lock(mutex);
+
+        for (const std::unique_ptr<SearchThread>& searchThread : searchThreads) {
+            searchThread->board.copyFrom(board);
+            searchThread->board.setAccumulatorStack(useNNUE ? &searchThread->accumulators : nullptr);
+            searchThread->stats.reset();
+        }
+
+        TranspositionTable::getTT()->newSearch();
+        params = searchParams;
+        sendBestMove = reportBestMove;
+        bestMove = NO_MOVE;
+        runningHelpers = static_cast<int>(searchThreads.size()) - 1;
+        searching = true;
+        searchGeneration += 1;
+        engine.setSearchStopped(false);
+    }
+
+    startCondition.notify_all();
+}
+
+void ThreadPool::stopSearch() {
+    engine.setSearchStopped(true);
+    waitForSearchFinished();
+}
+
+void ThreadPool::waitForSearchFinished() {
+    std::unique_lock lock(mutex);
+    finishedCondition.wait(lock, [this] { return !searching; });
+}
+
+Move ThreadPool::getBestMove() {
+    std::lock_guard lock(mutex);
+    return bestMove;
+}
+
+uint64_t ThreadPool::getNodesSearched() const {
+    uint64_t nodes = 0;
+
+    for (const std::unique_ptr<SearchThread>& searchThread : searchThreads) {
+        nodes += searchThread->stats.nodesSearched.load(std::memory_order_relaxed);
+        nodes += searchThread->stats.qNodesSearched.load(std::memory_order_relaxed);
+    }
+
+    return nodes;
+}
+
+void ThreadPool::getTTStatistics(uint64_t& ttProbes, uint64_t& ttHits) const {
+    ttProbes = 0;
+    ttHits = 0;
+
+    for (const std::unique_ptr<SearchThread>& searchThread : searchThreads) {
+        ttProbes += searchThread->stats.ttProbes;
+        ttHits += searchThread->stats.ttHits;
+    }
+}
+
+void ThreadPool::getEvalCacheStatistics(uint64_t& cacheHits, uint64_t& cacheMisses) const {
+    cacheHits = 0;
+    cacheMisses = 0;
+
+    for (const std::unique_ptr<SearchThread>& searchThread : searchThreads) {
+        cacheHits += searchThread->stats.evalCacheHits;
+        cacheMisses += searchThread->stats.evalCacheMisses;
+    }
+}
+
+uint64_t ThreadPool::getLazyEvals() const {
+    uint64_t lazyEvals = 0;
+
+    for (const std::unique_ptr<SearchThread>& searchThread : searchThreads) {
+        lazyEvals += searchThread->stats.lazyEvals;
+    }
+
+    return lazyEvals;
+}
+
+void ThreadPool::idleLoop(const int threadId, uint64_t lastGeneration) {
+    SearchThread& searchThread = *searchThreads[threadId];
+
+    while (true) {
+        {
+            std::unique_lock lock(mutex);
+            startCondition.wait(lock, [this, lastGeneration] {
+                return exiting || searchGeneration != lastGeneration;
+            });
+
+            if (exiting) {
+                return;
+            }
+
+            lastGeneration = searchGeneration;
+        }
+
+        Move move;
+
+        if (searchThread.board.getSideToMove() == WHITE) {
+            move = search<WHITE>(engine, searchThread, params);
+        } else {
+            move = search<BLACK>(engine, searchThread, params);
+        }
+
+        if (!searchThread.isMainThread()) {
+            std::lock_guard lock(mutex);
+            runningHelpers -= 1;
+            finishedCondition.notify_all();
+            continue;
+        }
+
+        // The main thread is done, so the helpers have to stop as well. Only report the move once they all stopped,
+        // so nothing is still searching when the GUI sends the next command.
+        engine.setSearchStopped(true);
+
+        std::unique_lock lock(mutex);
+        finishedCondition.wait(lock, [this] { return runningHelpers == 0; });
+
+        if (sendBestMove) {
+            engine.sendMessage("bestmove " + getMoveNotation(move));
+        }
+
+        bestMove = move;
+        searching = false;
+        finishedCondition.notify_all();
+    }
+}
+} // namespace Zagreus
@@ -0,0 +1,149 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "move.h"
+#include "search.h"
+
+namespace Zagreus {
+class Engine;
+
+/**
+ * \brief A persistent pool of search threads. The threads are created once and sleep on a condition variable until a
+ * search is started. Thread 0 is the main search thread, the others are Lazy SMP helpers.
+ */
+class ThreadPool {
+private:
+    Engine& engine;
+    std::vector<std::unique_ptr<SearchThread>> searchThreads{};
+    std::vector<std::thread> workers{};
+    std::mutex mutex{};
+    std::condition_variable startCondition{};
+    std::condition_variable finishedCondition{};
+    SearchParams params{};
+    uint64_t searchGeneration = 0;
+    int evalCacheSize = 0;
+    bool useNNUE = false;
+    int runningHelpers = 0;
+    bool searching = false;
+    bool exiting = false;
+    bool sendBestMove = true;
+    Move bestMove = NO_MOVE;
+
+    /**
+     * \brief The loop every worker runs. Sleeps until a new search is started, searches and goes back to sleep.
+     * \param threadId The id of the search thread this worker runs.
+     * \param lastGeneration The search generation at the time the worker was created.
+     */
+    void idleLoop(int threadId, uint64_t lastGeneration);
+
+    /**
+     * \brief Stops and joins all worker threads.
+     */
+    void joinWorkers();
+
+public:
+    explicit ThreadPool(Engine& engine) : engine(engine) {}
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * \brief Waits for a running search to end and recreates the pool with the given amount of threads.
+     * \param threadCount The amount of search threads, at least 1.
+     */
+    void resize(int threadCount);
+
+    /**
+     * \brief Waits for a running search to end and resizes the evaluation cache of every search thread.
+     * \param megaBytes The size of the cache of a single thread in megabytes. 0 disables the cache.
+     */
+    void setEvalCacheSize(int megaBytes);
+
+    /**
+     * \brief Waits for a running search to end and selects the evaluation used by the following searches.
+     * \param enabled If true, positions are evaluated with the loaded network. A network has to be loaded.
+     */
+    void setUseNNUE(bool enabled);
+
+    /**
+     * \brief Starts a search on the given board and returns immediately. Waits for a previous search to end first.
+     * \param board The root position. It is copied to every search thread.
+     * \param searchParams The search parameters.
+     * \param reportBestMove If true, the main thread sends "bestmove" when the search is finished.
+     */
+    void startSearch(const Board& board, const SearchParams& searchParams, bool reportBestMove = true);
+
+    /**
+     * \brief Signals all threads to stop and waits until the search has ended and the best move has been sent.
+     */
+    void stopSearch();
+
+    /**
+     * \brief Blocks until no search is running anymore.
+     */
+    void waitForSearchFinished();
+
+    /**
+     * \brief Gets the best move of the last finished search.
+     * \return The best move, or NO_MOVE if no search finished yet.
+     */
+    [[nodiscard]] Move getBestMove();
+
+    /**
+     * \brief Sums up the nodes searched by all threads in the current or last search.
+     * \return The total amount of nodes searched.
+     */
+    [[nodiscard]] uint64_t getNodesSearched() const;
+
+    /**
+     * \brief Sums up the transposition table statistics of all threads. Only valid once the search has finished.
+     * \param ttProbes Set to the amount of transposition table probes.
+     * \param ttHits Set to the amount of probes that found an entry of the position.
+     */
+    void getTTStatistics(uint64_t& ttProbes, uint64_t& ttHits) const;
+
+    /**
+     * \brief Sums up the evaluation cache statistics of all threads. Only valid once the search has finished.
+     * \param cacheHits Set to the amount of evaluations that were found in a cache.
+     * \param cacheMisses Set to the amount of evaluations that had to be computed.
+     */
+    void getEvalCacheStatistics(uint64_t& cacheHits, uint64_t& cacheMisses) const;
+
+    /**
+     * \brief Sums up the evaluations of all threads that stopped early because the score was far outside the window.
+     * Only valid once the search has finished.
+     * \return The amount of lazy evaluations.
+     */
+    [[nodiscard]] uint64_t getLazyEvals() const;
+};
+} // namespace Zagreus
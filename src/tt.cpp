@@ -20,97 +20,429 @@
 
 #include "tt.h"
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <thread>
+#include <vector>
 #include "constants.h"
+#include "tablebase.h"
+
+#if defined(_WIN32)
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace Zagreus {
+uint64_t TranspositionTable::packEntry(const uint64_t zobristHash, const int16_t score, const Move bestMove,
+                                       const int8_t depth, const TTNodeType nodeType, const uint8_t generation) {
+    return static_cast<uint64_t>(bestMove)
+           | static_cast<uint64_t>(static_cast<uint16_t>(score)) << 16
+           | static_cast<uint64_t>(static_cast<uint8_t>(depth)) << 32
+           | static_cast<uint64_t>(nodeType & 0b11) << 40
+           | static_cast<uint64_t>(generation & GENERATION_MASK) << GENERATION_SHIFT
+           | (zobristHash & VALIDATION_MASK) << VALIDATION_SHIFT;
+}
+
+TTEntry TranspositionTable::unpackEntry(const uint64_t packedEntry) {
+    TTEntry entry{};
+
+    entry.bestMove = static_cast<Move>(packedEntry & 0xFFFF);
+    entry.score = static_cast<int16_t>((packedEntry >> 16) & 0xFFFF);
+    entry.depth = static_cast<int8_t>((packedEntry >> 32) & 0xFF);
+    entry.nodeType = static_cast<TTNodeType>((packedEntry >> 40) & 0b11);
+    entry.generation = static_cast<uint8_t>((packedEntry >> GENERATION_SHIFT) & GENERATION_MASK);
+    entry.validationHash = static_cast<uint32_t>(packedEntry >> VALIDATION_SHIFT);
+
+    return entry;
+}
+
+/**
+ * \brief Returns true for mate and tablebase scores, which hold a distance in plies and are stored relative to the
+ * position instead of the root.
+ */
+static bool isDistanceScore(const int score) {
+    return std::abs(score) >= TB_WIN_SCORE - MAX_PLIES;
+}
+
+/**
+ * \brief Packs a static evaluation together with the hash bits that validate it.
+ */
+static uint32_t packEval(const uint64_t zobristHash, const int staticEval) {
+    return static_cast<uint32_t>(zobristHash & 0xFFFF0000) | static_cast<uint16_t>(staticEval);
+}
+
 void TranspositionTable::savePosition(const uint64_t zobristHash, const int8_t depth, const int ply, int score,
-                                      const Move bestMove, const TTNodeType nodeType) const {
-    const uint64_t index = zobristHash & hashSize;
-    TTEntry* entry = &transpositionTable[index];
-
-    // Only replace the entry if:
-    // 1. Validation hash is 0 (the entry is empty)
-    // 1. Depth > 0 (the new node is a pvSearch node, can replace any node)
-    // 2. The entries' depth < 0 (the entry is a qSearch node, can be replaced by any node)
-    if (entry->validationHash == 0 || depth > 0 || entry->depth < 0) {
-        if (score >= (MATE_SCORE - MAX_PLIES)) {
-            score += ply;
-        } else if (score <= (-MATE_SCORE + MAX_PLIES)) {
-            score -= ply;
+                                      Move bestMove, const TTNodeType nodeType, const int staticEval) const {
+    TTCluster& cluster = getCluster(zobristHash);
+    const uint64_t validationKey = zobristHash & VALIDATION_MASK;
+    int replacedIndex = 0;
+    int lowestValue = INT32_MAX;
+    bool samePosition = false;
+
+    // Every entry is a single word, so another thread can only replace it as a whole. No locking is needed.
+    for (int i = 0; i < TT_CLUSTER_SIZE; i++) {
+        const uint64_t packedEntry = cluster.entries[i].load(std::memory_order_relaxed);
+
+        if (packedEntry == 0) {
+            replacedIndex = i;
+            break;
         }
 
-        score = std::clamp(score, INT16_MIN, INT16_MAX);
+        const TTEntry entry = unpackEntry(packedEntry);
+
+        if ((packedEntry >> VALIDATION_SHIFT) == validationKey) {
+            // Keep a deeper entry of the same position from the current search, unless the new score is exact
+            if (entry.generation == generation && nodeType != EXACT && depth < entry.depth - 3) {
+                if (staticEval != NO_EVAL_SCORE) {
+                    cluster.evals[i].store(packEval(zobristHash, staticEval), std::memory_order_relaxed);
+                }
 
-        entry->validationHash = zobristHash >> 32;
-        entry->depth = depth;
-        entry->bestMove = bestMove;
-        entry->score = score;
-        entry->nodeType = nodeType;
+                return;
+            }
+
+            if (bestMove == NO_MOVE) {
+                bestMove = entry.bestMove;
+            }
+
+            replacedIndex = i;
+            samePosition = true;
+            break;
+        }
+
+        // Otherwise, replace the entry with the least value: shallow entries and entries of earlier searches
+        const int age = (generation - entry.generation) & GENERATION_MASK;
+        const int value = entry.depth - 8 * age;
+
+        if (value < lowestValue) {
+            lowestValue = value;
+            replacedIndex = i;
+        }
     }
+
+    if (isDistanceScore(score)) {
+        score += score > 0 ? ply : -ply;
+    }
+
+    score = std::clamp(score, INT16_MIN, INT16_MAX);
+    cluster.entries[replacedIndex].store(
+        packEntry(zobristHash, static_cast<int16_t>(score), bestMove, depth, nodeType, generation),
+        std::memory_order_relaxed);
+
+    if (staticEval != NO_EVAL_SCORE) {
+        cluster.evals[replacedIndex].store(packEval(zobristHash, staticEval), std::memory_order_relaxed);
+    } else if (!samePosition) {
+        // Don't leave the evaluation of the replaced position behind. The hash check would reject it anyway.
+        cluster.evals[replacedIndex].store(0, std::memory_order_relaxed);
+    }
+}
+
+int16_t TranspositionTable::probePosition(const uint64_t zobristHash, const int8_t depth, const int alpha,
+                                          const int beta, const int ply, bool& ttHit) const {
+    int16_t staticEval = NO_EVAL_SCORE;
+
+    return probePosition(zobristHash, depth, alpha, beta, ply, ttHit, staticEval);
 }
 
 int16_t TranspositionTable::probePosition(const uint64_t zobristHash, const int8_t depth, const int alpha,
-                                          const int beta, const int ply) const {
-    const uint64_t index = zobristHash & hashSize;
-    const uint32_t validationHash = zobristHash >> 32;
-    const TTEntry* entry = &transpositionTable[index];
+                                          const int beta, const int ply, bool& ttHit, int16_t& staticEval) const {
+    TTEntry entry{};
+
+    ttHit = getEntry(zobristHash, entry);
+    staticEval = entry.staticEval;
+
+    if (ttHit && entry.depth >= depth) {
+        int adjustedScore = entry.score;
+
+        if (isDistanceScore(adjustedScore)) {
+            adjustedScore -= adjustedScore > 0 ? ply : -ply;
+        }
 
-    if (entry->validationHash == validationHash && entry->depth >= depth) {
         bool returnScore = false;
 
-        if (entry->nodeType == EXACT) {
+        if (entry.nodeType == EXACT) {
             returnScore = true;
-        } else if (entry->nodeType == ALPHA) {
-            if (entry->score <= alpha) {
+        } else if (entry.nodeType == ALPHA) {
+            if (adjustedScore <= alpha) {
                 returnScore = true;
             }
-        } else if (entry->nodeType == BETA) {
-            if (entry->score >= beta) {
+        } else if (entry.nodeType == BETA) {
+            if (adjustedScore >= beta) {
                 returnScore = true;
             }
         }
 
         if (returnScore) {
-            int adjustedScore = entry->score;
+            return adjustedScore;
+        }
+    }
+
+    return NO_TT_SCORE;
+}
+
+bool TranspositionTable::getEntry(const uint64_t zobristHash, TTEntry& entry) const {
+    const TTCluster& cluster = getCluster(zobristHash);
+    const uint64_t validationKey = zobristHash & VALIDATION_MASK;
+
+    for (int i = 0; i < TT_CLUSTER_SIZE; i++) {
+        // Load the entry once, all fields are then taken from the same write
+        const uint64_t packedEntry = cluster.entries[i].load(std::memory_order_relaxed);
+
+        // Check validation hash to avoid hash collisions
+        if (packedEntry != 0 && (packedEntry >> VALIDATION_SHIFT) == validationKey) {
+            const uint32_t packedEval = cluster.evals[i].load(std::memory_order_relaxed);
+
+            entry = unpackEntry(packedEntry);
 
-            if (adjustedScore >= MATE_SCORE) {
-                adjustedScore -= ply;
-            } else if (adjustedScore <= -MATE_SCORE) {
-                adjustedScore += ply;
+            if (packedEval != 0 && (packedEval & 0xFFFF0000) == (zobristHash & 0xFFFF0000)) {
+                entry.staticEval = static_cast<int16_t>(packedEval & 0xFFFF);
             }
 
-            return adjustedScore;
+            return true;
         }
     }
 
-    return NO_TT_SCORE;
+    return false;
 }
 
-TTEntry* TranspositionTable::getEntry(const uint64_t zobristHash) const {
-    const uint64_t index = zobristHash & hashSize;
-    TTEntry* entry = &transpositionTable[index];
+TTCluster* TranspositionTable::allocateTable(const uint64_t clusterCount) {
+    constexpr uint64_t alignment = 2 * 1024 * 1024;
+    // The size has to be a multiple of the alignment for aligned_alloc
+    const uint64_t byteSize = (clusterCount * sizeof(TTCluster) + alignment - 1) / alignment * alignment;
+
+#if defined(_WIN32)
+    void* memory = _aligned_malloc(byteSize, alignment);
+#else
+    void* memory = std::aligned_alloc(alignment, byteSize);
+#endif
+
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // Ask for transparent huge pages to reduce TLB misses. If the kernel doesn't support it, regular pages are used.
+    madvise(memory, byteSize, MADV_HUGEPAGE);
+#endif
+
+    return static_cast<TTCluster*>(memory);
+}
 
-    // Check validation hash to avoid hash collisions
-    if (entry->validationHash == (zobristHash >> 32)) {
-        return entry;
+void TranspositionTable::freeTable() {
+#if !defined(_WIN32)
+    if (mappedFile != nullptr) {
+        munmap(mappedFile, mappedFileSize);
+        mappedFile = nullptr;
+        mappedFileSize = 0;
+        transpositionTable = nullptr;
+        return;
     }
+#endif
 
-    return nullptr;
+#if defined(_WIN32)
+    _aligned_free(transpositionTable);
+#else
+    std::free(transpositionTable);
+#endif
+    transpositionTable = nullptr;
 }
 
-void TranspositionTable::setTableSize(int megaBytes) {
-    if ((megaBytes & (megaBytes - 1)) != 0) {
-        megaBytes = 1 << static_cast<int>(log2(megaBytes));
+void TranspositionTable::clearTable(int threadCount) {
+    // Small tables are not worth starting threads for
+    constexpr uint64_t minClustersPerThread = 1024 * 1024 / sizeof(TTCluster);
+
+    const uint64_t maxThreads = std::max(clusterCount / minClustersPerThread, static_cast<uint64_t>(1));
+
+    threadCount = static_cast<int>(std::clamp(static_cast<uint64_t>(threadCount), static_cast<uint64_t>(1),
+                                              maxThreads));
+
+    auto clearChunk = [this, threadCount](const int threadId) {
+        const uint64_t start = clusterCount * threadId / threadCount;
+        const uint64_t end = clusterCount * (threadId + 1) / threadCount;
+
+        for (uint64_t i = start; i < end; i++) {
+            // Placement new, because the memory of a new table holds no objects yet
+            new (&transpositionTable[i]) TTCluster{};
+        }
+    };
+
+    std::vector<std::thread> threads{};
+
+    for (int threadId = 1; threadId < threadCount; threadId++) {
+        threads.emplace_back(clearChunk, threadId);
     }
 
-    const uint64_t byteSize = megaBytes * 1024 * 1024;
-    const uint64_t entryCount = byteSize / sizeof(TTEntry);
+    clearChunk(0);
 
-    delete[] transpositionTable;
-    transpositionTable = new TTEntry[entryCount]{};
-    hashSize = entryCount - 1;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void TranspositionTable::reset(const int threadCount) {
+    clearTable(threadCount);
+    generation = 0;
+
+    for (int color = 0; color < COLORS; color++) {
+        for (int fromSquare = 0; fromSquare < SQUARES; fromSquare++) {
+            std::fill_n(history[color][fromSquare], SQUARES, 0);
+        }
+    }
+}
+
+void TranspositionTable::clearStaticEvals() const {
+    for (uint64_t i = 0; i < clusterCount; i++) {
+        for (std::atomic<uint32_t>& eval : transpositionTable[i].evals) {
+            eval.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void TranspositionTable::setTableSize(const int megaBytes, const int threadCount) {
+    const uint64_t byteSize = static_cast<uint64_t>(megaBytes) * 1024 * 1024;
+
+    // Any size can be used, getCluster doesn't need a power of two
+    clusterCount = byteSize / sizeof(TTCluster);
+    freeTable();
+    transpositionTable = allocateTable(clusterCount);
+    generation = 0;
+    clearTable(threadCount);
+}
+
+bool TranspositionTable::saveToFile(const std::string& path, const uint8_t savedGeneration) const {
+    const std::string temporaryPath = path + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+    if (!file) {
+        return false;
+    }
+
+    TTFileHeader header{};
+
+    header.clusterCount = clusterCount;
+    header.generation = savedGeneration;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // A plain copy of a cluster with the same layout, filled with atomic loads
+    struct ClusterData {
+        uint64_t entries[TT_CLUSTER_SIZE];
+        uint32_t evals[TT_CLUSTER_SIZE];
+        uint32_t padding;
+    };
+
+    static_assert(sizeof(ClusterData) == sizeof(TTCluster));
+
+    constexpr uint64_t chunkSize = 16384;
+    std::vector<ClusterData> buffer(chunkSize);
+
+    for (uint64_t start = 0; start < clusterCount && file; start += chunkSize) {
+        const uint64_t end = std::min(start + chunkSize, clusterCount);
+
+        for (uint64_t i = start; i < end; i++) {
+            ClusterData& data = buffer[i - start];
+
+            for (int j = 0; j < TT_CLUSTER_SIZE; j++) {
+                data.entries[j] = transpositionTable[i].entries[j].load(std::memory_order_relaxed);
+                data.evals[j] = transpositionTable[i].evals[j].load(std::memory_order_relaxed);
+            }
+
+            data.padding = 0;
+        }
+
+        file.write(reinterpret_cast<const char*>(buffer.data()),
+                   static_cast<std::streamsize>((end - start) * sizeof(ClusterData)));
+    }
+
+    file.close();
+
+    if (!file) {
+        return false;
+    }
+
+    std::error_code error{};
+    std::filesystem::rename(temporaryPath, path, error);
+    return !error;
+}
+
+bool TranspositionTable::loadFromFile(const std::string& path) {
+    TTFileHeader header{};
+    const TTFileHeader expectedHeader{};
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return false;
+    }
+
+    const uint64_t expectedFileSize = sizeof(TTFileHeader) + header.clusterCount * sizeof(TTCluster);
+    std::error_code error{};
+
+    if (std::memcmp(header.magic, expectedHeader.magic, sizeof(header.magic)) != 0
+        || header.layoutVersion != TT_FILE_LAYOUT_VERSION || header.clusterSize != sizeof(TTCluster)
+        || header.clusterCount == 0 || std::filesystem::file_size(path, error) != expectedFileSize || error) {
+        return false;
+    }
+
+#if defined(_WIN32)
+    TTCluster* table = allocateTable(header.clusterCount);
+
+    if (!file.read(reinterpret_cast<char*>(table), static_cast<std::streamsize>(expectedFileSize - sizeof(header)))) {
+        _aligned_free(table);
+        return false;
+    }
+
+    freeTable();
+    transpositionTable = table;
+#else
+    const int fileDescriptor = open(path.c_str(), O_RDONLY);
+
+    if (fileDescriptor == -1) {
+        return false;
+    }
+
+    // A private mapping, so writes of the search go to memory and never to the file
+    void* memory = mmap(nullptr, expectedFileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileDescriptor, 0);
+    close(fileDescriptor);
+
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+
+    freeTable();
+    mappedFile = memory;
+    mappedFileSize = expectedFileSize;
+    transpositionTable = reinterpret_cast<TTCluster*>(static_cast<char*>(memory) + sizeof(TTFileHeader));
+#endif
+
+    clusterCount = header.clusterCount;
+    generation = header.generation & GENERATION_MASK;
+    return true;
+}
+
+int TranspositionTable::getHashFull() const {
+    const uint64_t sampleSize = std::min(clusterCount, static_cast<uint64_t>(1000));
+    int usedEntries = 0;
+
+    for (uint64_t i = 0; i < sampleSize; i++) {
+        for (const std::atomic<uint64_t>& slot : transpositionTable[i].entries) {
+            const uint64_t packedEntry = slot.load(std::memory_order_relaxed);
+
+            if (packedEntry != 0 && unpackEntry(packedEntry).generation == generation) {
+                usedEntries += 1;
+            }
+        }
+    }
+
+    return static_cast<int>(usedEntries * 1000 / (sampleSize * TT_CLUSTER_SIZE));
+}
 
-    std::fill_n(transpositionTable, entryCount, TTEntry{});
+void TranspositionTable::newSearch() {
+    generation = (generation + 1) & GENERATION_MASK;
 }
 
 TranspositionTable* TranspositionTable::getTT() {
@@ -123,8 +455,10 @@ void TranspositionTable::updateHistory(const Move move, const int value) {
     const Square from = getFromSquare(move);
     const Square to = getToSquare(move);
     const int clampedValue = std::clamp(value, -MAX_HISTORY, MAX_HISTORY);
+    const int currentValue = history[color][from][to].load(std::memory_order_relaxed);
 
-    history[color][from][to] += clampedValue - history[color][from][to] * std::abs(clampedValue) / MAX_HISTORY;
+    history[color][from][to].store(currentValue + clampedValue - currentValue * std::abs(clampedValue) / MAX_HISTORY,
+                                   std::memory_order_relaxed);
 }
 
 template void TranspositionTable::updateHistory<WHITE>(Move move, int value);
@@ -22,7 +22,10 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <string>
+#include "constants.h"
 #include "move.h"
 
 namespace Zagreus {
@@ -32,51 +35,234 @@ enum TTNodeType : uint8_t {
     BETA
 };
 
+/**
+ * \brief A decoded transposition table entry. The table itself stores every entry packed into a single 64-bit atomic,
+ * so an entry is always read and written as a whole and concurrent search threads can never observe a torn entry.
+ *
+ * Layout of a packed entry, from the least significant bit:
+ * - bits 0-15: best move
+ * - bits 16-31: score
+ * - bits 32-39: depth
+ * - bits 40-41: node type
+ * - bits 42-47: generation of the search that stored the entry
+ * - bits 48-63: validation key, the lower 16 bits of the zobrist hash
+ *
+ * The static evaluation does not fit in the packed entry and is stored in a separate 32-bit atomic next to it. See
+ * TTCluster.
+ */
 struct TTEntry {
     uint32_t validationHash = 0;
     int16_t score = 0;
     Move bestMove = NO_MOVE;
     int8_t depth = INT8_MIN;
     TTNodeType nodeType = EXACT;
+    uint8_t generation = 0;
+    int16_t staticEval = NO_EVAL_SCORE;
+};
+
+constexpr int TT_CLUSTER_SIZE = 5;
+
+/**
+ * \brief A group of entries that share one table index. A cluster is exactly one cache line, so a probe costs at most
+ * one cache miss. The upper bits of the zobrist hash select the cluster, the lower bits validate the entry.
+ *
+ * evals[i] holds the static evaluation of entries[i] in its lower 16 bits and bits 16-31 of the zobrist hash in its
+ * upper 16 bits. The two words are written separately, so the hash bits are checked on every read to make sure the
+ * evaluation belongs to the position of the entry.
+ */
+struct alignas(64) TTCluster {
+    std::atomic<uint64_t> entries[TT_CLUSTER_SIZE]{};
+    std::atomic<uint32_t> evals[TT_CLUSTER_SIZE]{};
+    uint32_t padding = 0;
 };
 
+static_assert(sizeof(TTCluster) == 64);
+
+// Must be increased whenever the layout of a packed entry or a cluster changes, so old files are rejected
+constexpr uint32_t TT_FILE_LAYOUT_VERSION = 2;
+
+/**
+ * \brief The header of a transposition table file. It is followed by the clusters, exactly as they are in memory.
+ * The header is one cache line, so the clusters in a memory mapped file stay aligned.
+ */
+struct TTFileHeader {
+    char magic[8]{'Z', 'A', 'G', 'R', 'E', 'U', 'S', 'T'};
+    uint32_t layoutVersion = TT_FILE_LAYOUT_VERSION;
+    uint32_t clusterSize = sizeof(TTCluster);
+    uint64_t clusterCount = 0;
+    uint8_t generation = 0;
+    uint8_t padding[39]{};
+};
+
+static_assert(sizeof(TTFileHeader) == sizeof(TTCluster));
+
 class TranspositionTable {
 private:
-    int history[COLORS][SQUARES][SQUARES]{};
+    static constexpr int VALIDATION_SHIFT = 48;
+    static constexpr uint64_t VALIDATION_MASK = 0xFFFF;
+    static constexpr int GENERATION_SHIFT = 42;
+    static constexpr uint8_t GENERATION_MASK = 0x3F;
+
+    // Bumped at the start of every search, so entries of earlier searches are replaced first
+    uint8_t generation = 0;
+
+    /**
+     * \brief Packs the given entry fields and the validation key of the zobrist hash into a single 64-bit value.
+     */
+    [[nodiscard]] static uint64_t packEntry(uint64_t zobristHash, int16_t score, Move bestMove, int8_t depth,
+                                            TTNodeType nodeType, uint8_t generation);
+
+    /**
+     * \brief Unpacks a 64-bit value created by packEntry.
+     */
+    [[nodiscard]] static TTEntry unpackEntry(uint64_t packedEntry);
+
+    /**
+     * \brief Maps the zobrist hash to a cluster with a multiply-high, so the table can have any amount of clusters.
+     */
+    [[nodiscard]] TTCluster& getCluster(const uint64_t zobristHash) const {
+        const auto index = static_cast<uint64_t>(static_cast<unsigned __int128>(zobristHash) * clusterCount >> 64);
+
+        return transpositionTable[index];
+    }
+
+    // Shared between all search threads, so accesses are relaxed atomics. Lost updates are harmless for move ordering.
+    std::atomic<int> history[COLORS][SQUARES][SQUARES]{};
+
+    /**
+     * \brief Allocates memory for the given amount of clusters, aligned to 2 MB so it can be backed by huge pages.
+     * The memory is not initialized.
+     */
+    [[nodiscard]] static TTCluster* allocateTable(uint64_t clusterCount);
+
+    // Set if the table lives in a private memory mapping of a file created by saveToFile
+    void* mappedFile = nullptr;
+    uint64_t mappedFileSize = 0;
+
+    /**
+     * \brief Frees the table, whether it was allocated by allocateTable or mapped from a file.
+     */
+    void freeTable();
+
+    /**
+     * \brief Zeroes every cluster. The table is split into one chunk per thread, which also makes the clearing threads
+     * the first to touch the memory, so the OS maps the pages while clearing instead of during the search.
+     * \param threadCount The amount of threads to clear with.
+     */
+    void clearTable(int threadCount);
 
 public:
-    TTEntry* transpositionTable = new TTEntry[1]{};
-    uint64_t hashSize = 0;
+    TTCluster* transpositionTable = nullptr;
+    uint64_t clusterCount = 0;
 
-    TranspositionTable() = default;
+    TranspositionTable() {
+        clusterCount = 1;
+        transpositionTable = allocateTable(clusterCount);
+        clearTable(1);
+    }
 
     ~TranspositionTable() {
-        delete[] transpositionTable;
+        freeTable();
     }
 
-    void reset() {
-        std::fill_n(transpositionTable, hashSize + 1, TTEntry{});
+    /**
+     * \brief Clears all entries and the history table.
+     * \param threadCount The amount of threads used to clear the table.
+     */
+    void reset(int threadCount = 1);
 
-        for (int color = 0; color < COLORS; color++) {
-            for (int fromSquare = 0; fromSquare < SQUARES; fromSquare++) {
-                std::fill_n(history[color][fromSquare], SQUARES, 0);
-            }
-        }
-    }
+    /**
+     * \brief Removes the stored static evaluations, keeping the rest of the entries.
+     */
+    void clearStaticEvals() const;
 
     TranspositionTable(TranspositionTable& other) = delete;
     void operator=(const TranspositionTable&) = delete;
 
     static TranspositionTable* getTT();
 
-    void setTableSize(int megaBytes);
+    /**
+     * \brief Reallocates the table with the given size and clears it.
+     * \param megaBytes The size of the table in MB.
+     * \param threadCount The amount of threads used to clear the new table.
+     */
+    void setTableSize(int megaBytes, int threadCount = 1);
+
+    /**
+     * \brief Prefetches the cluster of the given position into the CPU cache, so a later probe does not stall on a
+     * cache miss.
+     * \param zobristHash The zobrist hash of the position.
+     */
+    void prefetch(const uint64_t zobristHash) const {
+        __builtin_prefetch(&getCluster(zobristHash));
+    }
+
+    /**
+     * \brief Writes the table to a file. Entries are copied with atomic loads, so this can run on a background thread
+     * while searching. The file is written under a temporary name first and renamed when complete.
+     * \param path The path of the file.
+     * \param savedGeneration The generation to store in the file, read with getGeneration before the save started.
+     * \return True if the file was written, false otherwise.
+     */
+    bool saveToFile(const std::string& path, uint8_t savedGeneration) const;
+
+    /**
+     * \brief Gets the generation of the current search. Must not be called while a new search is being started.
+     */
+    [[nodiscard]] uint8_t getGeneration() const {
+        return generation;
+    }
+
+    /**
+     * \brief Replaces the table by the contents of a file written by saveToFile. Where supported, the file is memory
+     * mapped copy-on-write, so the table is available immediately and pages are only read from disk when touched. The
+     * file itself is never modified. The table size changes to the size stored in the file.
+     * \param path The path of the file.
+     * \return True if the table was loaded, false if the file could not be read or has a different layout.
+     */
+    bool loadFromFile(const std::string& path);
+
+    /**
+     * \brief Estimates how full the table is, by sampling the first clusters for entries of the current search.
+     * \return The permille of entries used by the current search, as reported by "info hashfull".
+     */
+    [[nodiscard]] int getHashFull() const;
+
+    /**
+     * \brief Starts a new search generation. Must be called before the search threads are started.
+     */
+    void newSearch();
+
+    /**
+     * \brief Stores a position in the table.
+     * \param staticEval The static evaluation of the position, or NO_EVAL_SCORE if it is not known. If not known, an
+     * evaluation stored earlier for the same position is kept.
+     */
+    void savePosition(uint64_t zobristHash, int8_t depth, int ply, int score, Move bestMove, TTNodeType nodeType,
+                      int staticEval = NO_EVAL_SCORE) const;
 
-    void savePosition(uint64_t zobristHash, int8_t depth, int ply, int score, Move bestMove,
-                      TTNodeType nodeType) const;
+    /**
+     * \brief Probes the transposition table for a score that can be used at the given depth and bounds.
+     * \param ttHit Set to true if an entry of the position was found, even if its score can't be used.
+     * \return The score, or NO_TT_SCORE if no usable score was found.
+     */
+    [[nodiscard]] int16_t probePosition(uint64_t zobristHash, int8_t depth, int alpha, int beta, int ply,
+                                        bool& ttHit) const;
 
-    [[nodiscard]] int16_t probePosition(uint64_t zobristHash, int8_t depth, int alpha, int beta, int ply) const;
+    /**
+     * \brief Same as probePosition, but also returns the stored static evaluation.
+     * \param staticEval Set to the static evaluation of the position, or NO_EVAL_SCORE if it is not stored.
+     */
+    [[nodiscard]] int16_t probePosition(uint64_t zobristHash, int8_t depth, int alpha, int beta, int ply,
+                                        bool& ttHit, int16_t& staticEval) const;
 
-    [[nodiscard]] TTEntry* getEntry(uint64_t zobristHash) const;
+    /**
+     * \brief Looks up the entry of the given position.
+     * \param zobristHash The zobrist hash of the position.
+     * \param entry Set to the decoded entry if the position was found.
+     * \return True if the position was found, false otherwise.
+     */
+    [[nodiscard]] bool getEntry(uint64_t zobristHash, TTEntry& entry) const;
 
     template <PieceColor color>
     void updateHistory(Move move, int value);
@@ -86,14 +272,14 @@ public:
         const Square fromSquare = getFromSquare(move);
         const Square toSquare = getToSquare(move);
 
-        return history[color][fromSquare][toSquare];
+        return history[color][fromSquare][toSquare].load(std::memory_order_relaxed);
     }
 
     [[nodiscard]] int getHistoryValue(const PieceColor color, const Move move) const {
         const Square fromSquare = getFromSquare(move);
         const Square toSquare = getToSquare(move);
 
-        return history[color][fromSquare][toSquare];
+        return history[color][fromSquare][toSquare].load(std::memory_order_relaxed);
     }
 };
 } // namespace Zagreus
@@ -50,18 +50,22 @@ void initializeWeights() {
 }
 
 void updateEvaluationParameters() {
-    for (int phase = 0; phase < GAME_PHASES; ++phase) {
-        for (int piece = 0; piece < PIECE_TYPES; ++piece) {
-            evalMaterialValues[phase][piece] = static_cast<int>(std::round(
+    for (int piece = 0; piece < PIECE_TYPES; ++piece) {
+        int values[GAME_PHASES]{};
+
+        for (int phase = 0; phase < GAME_PHASES; ++phase) {
+            values[phase] = static_cast<int>(std::round(
                 baseMaterialValues[phase][piece] + weights[materialWeightStart + (phase * PIECE_TYPES) + piece]
             ));
 
             // Don't allow material values to be negative
-            if (evalMaterialValues[phase][piece] < 0) {
-                evalMaterialValues[phase][piece] = 0;
+            if (values[phase] < 0) {
+                values[phase] = 0;
                 weights[materialWeightStart + (phase * PIECE_TYPES) + piece] = -baseMaterialValues[phase][piece];
             }
         }
+
+        evalMaterialValues[piece] = makeScore(values[MIDGAME], values[ENDGAME]);
     }
 
     for (Piece piece = WHITE_PAWN; piece <= BLACK_KING; piece++) {
@@ -76,26 +80,29 @@ void updateEvaluationParameters() {
                                       ? getBaseEndgameTable(pieceType)[square ^ 56]
                                       : getBaseEndgameTable(pieceType)[square];
 
-            midgamePstTable[piece][square] = evalMaterialValues[MIDGAME][pieceType] +
-                                             static_cast<int>(std::round(baseMgPst + weights[mgIndex]));
-            endgamePstTable[piece][square] = evalMaterialValues[ENDGAME][pieceType] +
-                                             static_cast<int>(std::round(baseEgPst + weights[egIndex]));
+            pstTable[piece][square] = evalMaterialValues[pieceType] +
+                                      makeScore(static_cast<int>(std::round(baseMgPst + weights[mgIndex])),
+                                                static_cast<int>(std::round(baseEgPst + weights[egIndex])));
         }
     }
 
-    for (int phase = 0; phase < GAME_PHASES; ++phase) {
-        for (int piece = 0; piece < PIECE_TYPES; ++piece) {
+    for (int piece = 0; piece < PIECE_TYPES; ++piece) {
+        int values[GAME_PHASES]{};
+
+        for (int phase = 0; phase < GAME_PHASES; ++phase) {
             const int index = mobilityWeightStart + (phase * PIECE_TYPES) + piece;
-            evalMobility[phase][piece] = static_cast<int>(std::round(
+            values[phase] = static_cast<int>(std::round(
                 baseMobility[phase][piece] + weights[index]
                 ));
 
             // Don't allow mobility values to be negative
-            if (evalMobility[phase][piece] < 0) {
-                evalMobility[phase][piece] = 0;
+            if (values[phase] < 0) {
+                values[phase] = 0;
                 weights[index] = -baseMobility[phase][piece];
             }
         }
+
+        evalMobility[piece] = makeScore(values[MIDGAME], values[ENDGAME]);
     }
 }
 
@@ -212,51 +219,28 @@ void exportTunedValues(const std::string& outputPath, int finalEpoch, double tra
     fout << " * - Test error: " << testError << "\n";
     fout << " */\n\n";
 
+    // The material and mobility values are exported as packed scores, like they are declared in eval_features.cpp
+    auto exportPackedScores = [&fout](const std::string& name, const int (&baseValues)[GAME_PHASES][PIECE_TYPES],
+                                      const int weightStart) {
+        fout << "Score " << name << "[PIECE_TYPES] = {\n    ";
+        for (int piece = 0; piece < PIECE_TYPES; ++piece) {
+            const int mgValue = static_cast<int>(std::round(
+                baseValues[MIDGAME][piece] + weights[weightStart + (MIDGAME * PIECE_TYPES) + piece]
+            ));
+            const int egValue = static_cast<int>(std::round(
+                baseValues[ENDGAME][piece] + weights[weightStart + (ENDGAME * PIECE_TYPES) + piece]
+            ));
+            fout << "makeScore(" << mgValue << ", " << egValue << ")";
+            if (piece < PIECE_TYPES - 1) fout << ", ";
+        }
+        fout << "\n};\n\n";
+    };
+
     fout << "// Material values\n";
-    fout << "int evalMaterialValues[GAME_PHASES][PIECE_TYPES]{\n";
-    fout << "    {";
-    for (int piece = 0; piece < PIECE_TYPES; ++piece) {
-        const int value = static_cast<int>(std::round(
-            baseMaterialValues[MIDGAME][piece] + weights[materialWeightStart + (MIDGAME * PIECE_TYPES) + piece]
-        ));
-        fout << value;
-        if (piece < PIECE_TYPES - 1) fout << ", ";
-    }
-    fout << "}, // Midgame\n";
-    
-    fout << "    {";
-    for (int piece = 0; piece < PIECE_TYPES; ++piece) {
-        const int value = static_cast<int>(std::round(
-            baseMaterialValues[ENDGAME][piece] + weights[materialWeightStart + (ENDGAME * PIECE_TYPES) + piece]
-        ));
-        fout << value;
-        if (piece < PIECE_TYPES - 1) fout << ", ";
-    }
-    fout << "} // Endgame\n";
-    fout << "};\n\n";
+    exportPackedScores("evalMaterialValues", baseMaterialValues, materialWeightStart);
 
     fout << "// Mobility values\n";
-    fout << "int evalMobility[GAME_PHASES][PIECE_TYPES]{\n";
-    fout << "    {";
-    for (int piece = 0; piece < PIECE_TYPES; ++piece) {
-        const int value = static_cast<int>(std::round(
-            baseMobility[MIDGAME][piece] + weights[mobilityWeightStart + (MIDGAME * PIECE_TYPES) + piece]
-        ));
-        fout << value;
-        if (piece < PIECE_TYPES - 1) fout << ", ";
-    }
-    fout << "}, // Midgame\n";
-    
-    fout << "    {";
-    for (int piece = 0; piece < PIECE_TYPES; ++piece) {
-        const int value = static_cast<int>(std::round(
-            baseMobility[ENDGAME][piece] + weights[mobilityWeightStart + (ENDGAME * PIECE_TYPES) + piece]
-        ));
-        fout << value;
-        if (piece < PIECE_TYPES - 1) fout << ", ";
-    }
-    fout << "} // Endgame\n";
-    fout << "};\n\n";
+    exportPackedScores("evalMobility", baseMobility, mobilityWeightStart);
 
     const std::string pieceNames[] = {"pawn", "knight", "bishop", "rook", "queen", "king"};
 
@@ -21,29 +21,46 @@
 #include "uci.h"
 #include <algorithm>
 #include <cctype>
+#include <charconv>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <memory>
+#include <new>
 #include <sstream>
 #include <stdexcept>
 #include <string>
-#include <thread>
+#include <vector>
 
+#include "analysis_db.h"
 #include "bitboard.h"
 #include "board.h"
+#include "book.h"
 #include "eval_features.h"
 #include "magics.h"
 #include "move.h"
+#include "nnue.h"
 #include "perft.h"
-#include "pst.h"
 #include "search.h"
+#include "tablebase.h"
+#include "thread_pool.h"
 #include "tt.h"
 #include "types.h"
 
 namespace Zagreus {
 constexpr std::string_view startPosFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
+Engine::Engine() : threadPool(std::make_unique<ThreadPool>(*this)) {
+    // Needs to be here so the position command does not mess with the zobrist hash, while we still do the most expensive setup when the specification allows it
+    initZobristConstants();
+}
+
+// Defined here, because ThreadPool is incomplete in the header
+Engine::~Engine() {
+    waitForTTSave();
+}
+
 void Engine::doSetup() {
     // According to the UCI specification, bitboard, magic bitboards and other stuff should be done only when "isready" or "setoption" is called
     if (didSetup) {
@@ -55,10 +72,88 @@ void Engine::doSetup() {
     initializeMagicBitboards();
     initializeBetweenLookupTable();
     initializeAttackLookupTables();
-    initializePst();
 
     UCIOption hashOption = getOption("Hash");
-    TranspositionTable::getTT()->setTableSize(std::stoi(hashOption.getValue()));
+    UCIOption threadsOption = getOption("Threads");
+    UCIOption evalCacheOption = getOption("EvalCache");
+    const int threadCount = std::stoi(threadsOption.getValue());
+
+    TranspositionTable::getTT()->setTableSize(std::stoi(hashOption.getValue()), threadCount);
+    threadPool->setEvalCacheSize(std::stoi(evalCacheOption.getValue()));
+    setThreadCount(threadCount);
+    setupEvaluation(true);
+    setupTablebases();
+    setupBook();
+    setupAnalysisDatabase();
+}
+
+void Engine::setupEvaluation(const bool loadEvalFile) {
+    const std::string evalFile = getOption("EvalFile").getValue();
+    const bool useNNUE = getOption("UseNNUE").getValue() == "true";
+
+    if (loadEvalFile && !evalFile.empty() && evalFile != "<empty>") {
+        if (loadNetwork(evalFile)) {
+            sendInfoMessage("Loaded the network from " + evalFile);
+        } else {
+            sendMessage("ERROR: Could not load the network from " + evalFile);
+        }
+    }
+
+    if (useNNUE && !isNetworkLoaded()) {
+        sendInfoMessage("No network is loaded, using the handcrafted evaluation");
+    }
+
+    threadPool->setUseNNUE(useNNUE && isNetworkLoaded());
+}
+
+void Engine::setupBook() {
+    const std::string bookFile = getOption("BookFile").getValue();
+    OpeningBook* book = OpeningBook::getOpeningBook();
+
+    book->close();
+
+    if (bookFile.empty() || bookFile == "<empty>") {
+        return;
+    }
+
+    if (book->open(bookFile)) {
+        sendInfoMessage("Loaded the book " + bookFile + " (" + std::to_string(book->getEntryCount()) + " entries)");
+    } else {
+        sendMessage("ERROR: Could not load the book " + bookFile);
+    }
+}
+
+void Engine::setupAnalysisDatabase() {
+    const std::string databaseFile = getOption("AnalysisDB").getValue();
+    AnalysisDatabase* analysisDatabase = AnalysisDatabase::getAnalysisDatabase();
+
+    analysisDatabase->close();
+
+    if (databaseFile.empty() || databaseFile == "<empty>") {
+        return;
+    }
+
+    if (analysisDatabase->open(databaseFile)) {
+        sendInfoMessage("Opened the analysis database " + databaseFile + " (" +
+                        std::to_string(analysisDatabase->getRecordCount()) + " positions)");
+    } else {
+        sendMessage("ERROR: Could not open the analysis database " + databaseFile);
+    }
+}
+
+void Engine::setupTablebases() {
+    const std::string tablebaseDir = getOption("TablebaseDir").getValue();
+    Tablebases* tablebases = Tablebases::getTablebases();
+
+    tablebases->clear();
+
+    if (tablebaseDir.empty() || tablebaseDir == "<empty>") {
+        return;
+    }
+
+    const int loadedTables = tablebases->loadTables(tablebaseDir);
+
+    sendInfoMessage("Loaded " + std::to_string(loadedTables) + " tablebase files from " + tablebaseDir);
 }
 
 std::string Engine::getVersionString() {
@@ -95,6 +190,7 @@ along with this program. If not, see <https://www.gnu.org/licenses/>.)");
 
     sendMessage(
         "Zagreus UCI chess engine " + getVersionString() + " by Danny Jelsma (https://github.com/Dannyj1/Zagreus)");
+    sendMessage("Using the " + std::string(getInstructionSetName(getNNUEInstructionSet())) + " kernels");
     sendMessage("");
 }
 
@@ -120,6 +216,8 @@ void Engine::handleIsReadyCommand(std::string_view args) {
         doSetup();
     }
 
+    // Only report ready when the previous search has completely ended, so the GUI can safely send the next position
+    threadPool->waitForSearchFinished();
     sendMessage("readyok");
 }
 
@@ -187,18 +285,45 @@ void Engine::handleSetOptionCommand(const std::string& args) {
         }
     }
 
+    // Checked before the value is stored, so the stored value can always be parsed
+    int spinValue = 0;
+
+    if ((name == "Threads" || name == "EvalCache") && !option.parseSpinValue(value, spinValue)) {
+        sendMessage("ERROR: " + name + " must be an integer between " + option.getMinValue() + " and " +
+            option.getMaxValue() + ".");
+        return;
+    }
+
     option.setValue(value);
 
     if (!didSetup) {
         doSetup();
     } else if (name == "Hash") {
-        TranspositionTable::getTT()->setTableSize(std::stoi(value));
+        const int threadCount = std::stoi(getOption("Threads").getValue());
+
+        TranspositionTable::getTT()->setTableSize(std::stoi(value), threadCount);
+    } else if (name == "Threads") {
+        setThreadCount(spinValue);
+    } else if (name == "EvalCache") {
+        threadPool->setEvalCacheSize(spinValue);
+    } else if (name == "EvalFile") {
+        setupEvaluation(true);
+    } else if (name == "UseNNUE") {
+        setupEvaluation(false);
+    } else if (name == "TablebaseDir") {
+        setupTablebases();
+    } else if (name == "BookFile") {
+        setupBook();
+    } else if (name == "AnalysisDB") {
+        setupAnalysisDatabase();
     }
 }
 
 void Engine::handleUciNewGameCommand() {
+    const int threadCount = std::stoi(getOption("Threads").getValue());
+
     board.reset();
-    TranspositionTable::getTT()->reset();
+    TranspositionTable::getTT()->reset(threadCount);
 }
 
 void Engine::handlePositionCommand(const std::string_view args) {
@@ -320,9 +445,32 @@ void Engine::handleGoCommand(std::string_view args) {
         return;
     }
 
-    this->searchStopped = false;
+    Move bookMove = NO_MOVE;
+
+    // A book move is played right away, without starting a search
+    if (getOption("OwnBook").getValue() == "true" && OpeningBook::getOpeningBook()->probe(board, bookMove)) {
+        sendMessage("bestmove " + getMoveNotation(bookMove));
+        return;
+    }
+
+    const AnalysisDatabase* analysisDatabase = AnalysisDatabase::getAnalysisDatabase();
+    AnalysisRecord record{};
+
+    // A depth limited search that is stored with at least that depth is answered from the analysis database
+    if (depth > 0 && analysisDatabase->probe(board.getZobristHash(), getPolyglotKey(board), record)
+        && record.depth >= depth && record.getBestMove() != NO_MOVE) {
+        PvLine pvLine{0};
+
+        pvLine.moveCount = record.pvLength;
+        std::copy_n(record.pv.begin(), record.pvLength, pvLine.moves);
+        sendInfoMessage("depth " + std::to_string(record.depth) + " score cp " +
+                        std::to_string(scoreFromAnalysisDB(record.score, board.getPly())) + " nodes " +
+                        std::to_string(record.nodes) + " time 0 pv " + parsePvLine(pvLine));
+        sendMessage("bestmove " + getMoveNotation(record.getBestMove()));
+        return;
+    }
+
     SearchParams params{};
-    SearchStats stats{};
 
     params.whiteTime = whiteTime;
     params.blackTime = blackTime;
@@ -330,26 +478,20 @@ void Engine::handleGoCommand(std::string_view args) {
     params.blackInc = blackInc;
     params.depth = depth;
 
-    Move bestMove;
-
-    if (board.getSideToMove() == WHITE) {
-        bestMove = search<WHITE>(*this, board, params, stats);
-    } else {
-        bestMove = search<BLACK>(*this, board, params, stats);
-    }
-
-    sendMessage("bestmove " + getMoveNotation(bestMove));
+    // The search threads copy the board, so the UCI thread is free to handle other commands while searching
+    threadPool->startSearch(board, params);
 }
 
 void Engine::handleStopCommand() {
-    this->searchStopped = true;
-    sendInfoMessage("Search stopped.");
+    threadPool->stopSearch();
 }
 
 void Engine::handlePonderHitCommand(std::string_view args) {
 }
 
 void Engine::handleQuitCommand(std::string_view args) {
+    threadPool->stopSearch();
+    quitRequested = true;
 }
 
 void Engine::handlePerftCommand(const std::string& args) {
@@ -357,23 +499,40 @@ void Engine::handlePerftCommand(const std::string& args) {
         doSetup();
     }
 
-    if (args.empty() || args == " " || args == "\n") {
+    // Usage: perft <depth> [threads] [hash size in MB]
+    std::istringstream iss(args);
+    std::vector<std::string> arguments{};
+    std::string arg;
+
+    while (iss >> arg) {
+        arguments.push_back(arg);
+    }
+
+    if (arguments.empty()) {
         sendMessage("ERROR: No depth provided.");
         return;
     }
 
-    if (args.contains(' ')) {
+    if (arguments.size() > 3) {
         sendMessage("ERROR: Too many arguments provided.");
         return;
     }
 
     int depth = 0;
+    int threadCount = 1;
+    int hashSize = 0;
+    // Bounded like the options, so the perft cannot start absurd amounts of threads or allocate absurd tables
+    const int maxThreadCount = std::stoi(getOption("Threads").getMaxValue());
+    const int maxHashSize = std::stoi(getOption("Hash").getMaxValue());
 
     try {
-        depth = std::stoi(args);
+        depth = std::stoi(arguments[0]);
     } catch (const std::invalid_argument& e) {
         sendMessage("ERROR: Depth must be an integer.");
         return;
+    } catch (const std::out_of_range& e) {
+        sendMessage("ERROR: Depth is out of range.");
+        return;
     }
 
     if (depth <= 0) {
@@ -381,24 +540,190 @@ void Engine::handlePerftCommand(const std::string& args) {
         return;
     }
 
+    if (arguments.size() >= 2) {
+        try {
+            threadCount = std::stoi(arguments[1]);
+        } catch (const std::invalid_argument& e) {
+            sendMessage("ERROR: Thread count must be an integer.");
+            return;
+        } catch (const std::out_of_range& e) {
+            threadCount = -1;
+        }
+
+        if (threadCount <= 0 || threadCount > maxThreadCount) {
+            sendMessage("ERROR: Thread count must be between 1 and " + std::to_string(maxThreadCount) + ".");
+            return;
+        }
+    }
+
+    if (arguments.size() == 3) {
+        try {
+            hashSize = std::stoi(arguments[2]);
+        } catch (const std::invalid_argument& e) {
+            sendMessage("ERROR: Hash size must be an integer.");
+            return;
+        } catch (const std::out_of_range& e) {
+            hashSize = -1;
+        }
+
+        if (hashSize < 0 || hashSize > maxHashSize) {
+            sendMessage("ERROR: Hash size must be between 0 and " + std::to_string(maxHashSize) + ".");
+            return;
+        }
+    }
+
     if (board.getOccupiedBitboard() == 0ULL) {
         board.setFromFEN(startPosFEN);
     }
 
+    // A size of 0 counts every subtree without a table
+    std::unique_ptr<PerftTable> table = nullptr;
+
+    if (hashSize > 0) {
+        try {
+            table = std::make_unique<PerftTable>(hashSize);
+        } catch (const std::bad_alloc& e) {
+            sendMessage("ERROR: Could not allocate a perft hash table of " + std::to_string(hashSize) + " MB.");
+            return;
+        }
+    }
+
     const auto start = std::chrono::high_resolution_clock::now();
-    const uint64_t nodes = perft(board, depth);
+    const uint64_t nodes = perft(board, depth, true, threadCount, table.get());
     const auto end = std::chrono::high_resolution_clock::now();
     const std::string tookSeconds = std::to_string(std::chrono::duration<double>(end - start).count());
+    std::string message =
+        "Depth: " + std::to_string(depth) + ", Nodes: " + std::to_string(nodes) + ", Time: " + tookSeconds + "s";
 
-    sendInfoMessage(
-        "Depth: " + std::to_string(depth) + ", Nodes: " + std::to_string(nodes) + ", Time: " + tookSeconds + "s");
+    if (table) {
+        const uint64_t probes = table->getProbes();
+        const uint64_t hits = table->getHits();
+        const double hitRate = probes == 0 ? 0.0 : 100.0 * static_cast<double>(hits) / static_cast<double>(probes);
+
+        message += ", Hash hits: " + std::to_string(hits) + "/" + std::to_string(probes) + " (" +
+            std::to_string(hitRate) + "%)";
+    }
+
+    sendInfoMessage(message);
 }
 
 void Engine::handlePrintCommand() {
     board.print();
 }
 
+void Engine::handleSaveHashCommand(const std::string& args) {
+    if (!didSetup) {
+        doSetup();
+    }
+
+    if (args.empty()) {
+        sendMessage("ERROR: No file provided.");
+        return;
+    }
+
+    waitForTTSave();
+
+    // Saving a large table takes a while, so it runs in the background. Searching while saving is allowed, so the
+    // generation is read here, before a following search can start a new one.
+    const uint8_t generation = TranspositionTable::getTT()->getGeneration();
+
+    ttSaveThread = std::thread([this, args, generation] {
+        if (TranspositionTable::getTT()->saveToFile(args, generation)) {
+            sendInfoMessage("Saved the transposition table to " + args);
+        } else {
+            sendMessage("ERROR: Could not save the transposition table to " + args);
+        }
+    });
+}
+
+void Engine::handleLoadHashCommand(const std::string& args) {
+    if (!didSetup) {
+        doSetup();
+    }
+
+    if (args.empty()) {
+        sendMessage("ERROR: No file provided.");
+        return;
+    }
+
+    TranspositionTable* tt = TranspositionTable::getTT();
+
+    if (!tt->loadFromFile(args)) {
+        sendMessage("ERROR: Could not load the transposition table from " + args);
+        return;
+    }
+
+    // The table now has the size that is stored in the file
+    const uint64_t megaBytes = tt->clusterCount * sizeof(TTCluster) / (1024 * 1024);
+
+    getOption("Hash").setValue(std::to_string(megaBytes));
+    sendInfoMessage("Loaded the transposition table from " + args + " (" + std::to_string(megaBytes) + " MB)");
+}
+
+void Engine::handleGenerateTBCommand(const std::string& args) {
+    if (!didSetup) {
+        doSetup();
+    }
+
+    const std::string tablebaseDir = getOption("TablebaseDir").getValue();
+
+    if (tablebaseDir.empty() || tablebaseDir == "<empty>") {
+        sendMessage("ERROR: The TablebaseDir option is not set.");
+        return;
+    }
+
+    int pieceCount = TB_MAX_PIECES;
+
+    if (!args.empty()) {
+        try {
+            pieceCount = std::stoi(args);
+        } catch (const std::invalid_argument& e) {
+            sendMessage("ERROR: Piece count must be an integer.");
+            return;
+        } catch (const std::out_of_range& e) {
+            // Reported as out of bounds below
+            pieceCount = -1;
+        }
+    }
+
+    if (pieceCount < 3 || pieceCount > TB_MAX_PIECES) {
+        sendMessage("ERROR: The piece count must be between 3 and " + std::to_string(TB_MAX_PIECES) + ".");
+        return;
+    }
+
+    const int threadCount = std::stoi(getOption("Threads").getValue());
+    const bool success = Tablebases::getTablebases()->generateTables(
+        tablebaseDir, pieceCount, threadCount, [this](const std::string& name, const uint64_t timeMs) {
+            sendInfoMessage("Generated " + name + " in " + std::to_string(timeMs) + " ms");
+        });
+
+    if (!success) {
+        sendMessage("ERROR: Could not generate the tablebases in " + tablebaseDir);
+        return;
+    }
+
+    sendInfoMessage("Tablebases are ready (" + std::to_string(Tablebases::getTablebases()->getTableCount()) +
+                    " tables)");
+}
+
+void Engine::waitForTTSave() {
+    if (ttSaveThread.joinable()) {
+        ttSaveThread.join();
+    }
+}
+
 void Engine::processCommand(const std::string_view command, const std::string& args) {
+    // Commands that modify the board, the options or the transposition table may not run while searching
+    if (command == "setoption" || command == "ucinewgame" || command == "position" || command == "go" ||
+        command == "perft" || command == "print" || command == "loadhash" || command == "generatetb") {
+        threadPool->waitForSearchFinished();
+    }
+
+    // These commands free or clear the transposition table, which may still be in use by a background save
+    if (command == "setoption" || command == "ucinewgame" || command == "loadhash" || command == "quit") {
+        waitForTTSave();
+    }
+
     if (command == "uci") {
         handleUciCommand();
     } else if (command == "debug") {
@@ -414,9 +739,7 @@ void Engine::processCommand(const std::string_view command, const std::string& a
     } else if (command == "position") {
         handlePositionCommand(args);
     } else if (command == "go") {
-        std::thread searchThread{&Engine::handleGoCommand, this, args};
-
-        searchThread.detach();
+        handleGoCommand(args);
     } else if (command == "stop") {
         handleStopCommand();
     } else if (command == "ponderhit") {
@@ -427,6 +750,12 @@ void Engine::processCommand(const std::string_view command, const std::string& a
         handlePerftCommand(args);
     } else if (command == "print") {
         handlePrintCommand();
+    } else if (command == "savehash") {
+        handleSaveHashCommand(args);
+    } else if (command == "loadhash") {
+        handleLoadHashCommand(args);
+    } else if (command == "generatetb") {
+        handleGenerateTBCommand(args);
     } else {
         // If unknown, we must skip it and process the rest.
         if (args.empty() || args == " " || args == "\n") {
@@ -474,6 +803,18 @@ void Engine::setSearchStopped(bool value) {
     this->searchStopped = value;
 }
 
+void Engine::setThreadCount(const int threadCount) {
+    threadPool->resize(threadCount);
+}
+
+ThreadPool& Engine::getThreadPool() {
+    return *threadPool;
+}
+
+uint64_t Engine::getNodesSearched() const {
+    return threadPool->getNodesSearched();
+}
+
 void Engine::processLine(const std::string& inputLine) {
     std::string line = removeRedundantSpaces(inputLine);
     std::string command;
@@ -497,6 +838,30 @@ void Engine::processLine(const std::string& inputLine) {
 void Engine::registerOptions() {
     UCIOption hashOption{"Hash", Spin, "16", "1", "33554432"};
     addOption(hashOption);
+
+    UCIOption threadsOption{"Threads", Spin, "1", "1", "1024"};
+    addOption(threadsOption);
+
+    UCIOption evalCacheOption{"EvalCache", Spin, "0", "0", "1024"};
+    addOption(evalCacheOption);
+
+    UCIOption evalFileOption{"EvalFile", String, "<empty>"};
+    addOption(evalFileOption);
+
+    UCIOption useNNUEOption{"UseNNUE", Check, "false"};
+    addOption(useNNUEOption);
+
+    UCIOption tablebaseDirOption{"TablebaseDir", String, "<empty>"};
+    addOption(tablebaseDirOption);
+
+    UCIOption ownBookOption{"OwnBook", Check, "false"};
+    addOption(ownBookOption);
+
+    UCIOption bookFileOption{"BookFile", String, "<empty>"};
+    addOption(bookFileOption);
+
+    UCIOption analysisDBOption{"AnalysisDB", String, "<empty>"};
+    addOption(analysisDBOption);
 }
 
 void Engine::startUci() {
@@ -504,17 +869,22 @@ void Engine::startUci() {
     printStartupMessage();
     std::string line;
 
-    while (std::getline(std::cin, line)) {
+    while (!quitRequested && std::getline(std::cin, line)) {
         processLine(line);
     }
+
+    threadPool->stopSearch();
 }
 
 void Engine::sendInfoMessage(const std::string_view message) {
-    std::cout << "info " << message << std::endl;
+    sendMessage("info " + std::string(message));
 }
 
 void Engine::sendMessage(const std::string_view message) {
-    std::cout << message << std::endl;
+    const std::string line = std::string(message) + "\n";
+    std::scoped_lock lock(outputMutex);
+
+    std::cout << line << std::flush;
 }
 
 std::string removeRedundantSpaces(const std::string_view input) {
@@ -601,6 +971,22 @@ void UCIOption::setMaxValue(std::string value) {
     this->maxValue = value;
 }
 
+bool UCIOption::parseSpinValue(const std::string& value, int& result) {
+    int parsedValue = 0;
+    const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), parsedValue);
+
+    if (error != std::errc{} || end != value.data() + value.size()) {
+        return false;
+    }
+
+    if (parsedValue < std::stoi(minValue) || parsedValue > std::stoi(maxValue)) {
+        return false;
+    }
+
+    result = parsedValue;
+    return true;
+}
+
 std::string getUciOptionTypeAsString(const UCIOptionType type) {
     switch (type) {
         case Check:
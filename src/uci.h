@@ -20,9 +20,14 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -30,13 +35,20 @@
 
 namespace Zagreus {
 class UCIOption;
+class ThreadPool;
 
 class Engine {
 private:
     bool didSetup = false;
-    bool searchStopped = false;
+    bool quitRequested = false;
+    std::atomic<bool> searchStopped = false;
     std::map<std::string, UCIOption> options{};
     Board board{};
+    std::thread ttSaveThread{};
+    // The search threads and the background hash save write to stdout, so every line is written as a whole under it
+    std::mutex outputMutex{};
+    // Declared last, so the search threads are stopped before the rest of the engine is destroyed
+    std::unique_ptr<ThreadPool> threadPool;
 
     void handleUciCommand();
     void handleDebugCommand(std::string_view args);
@@ -50,14 +62,21 @@ private:
     void handleQuitCommand(std::string_view args);
     void handlePerftCommand(const std::string& args);
     void handlePrintCommand();
+    void handleSaveHashCommand(const std::string& args);
+    void handleLoadHashCommand(const std::string& args);
+    void handleGenerateTBCommand(const std::string& args);
+    void waitForTTSave();
+    void setupEvaluation(bool loadEvalFile);
+    void setupTablebases();
+    void setupBook();
+    void setupAnalysisDatabase();
     void processCommand(std::string_view command, const std::string& args);
     void processLine(const std::string& inputLine);
 
 public:
-    Engine() {
-        // Needs to be here so the position command does not mess with the zobrist hash, while we still do the most expensive setup when the specification allows it
-        initZobristConstants();
-    }
+    Engine();
+
+    ~Engine();
 
     Engine(const Engine&) = delete;
 
@@ -75,6 +94,9 @@ public:
     bool hasOption(const std::string& name) const;
     bool isSearchStopped() const;
     void setSearchStopped(bool value);
+    void setThreadCount(int threadCount);
+    [[nodiscard]] ThreadPool& getThreadPool();
+    [[nodiscard]] uint64_t getNodesSearched() const;
 };
 
 enum UCIOptionType {
@@ -125,6 +147,14 @@ public:
 
     void setMaxValue(std::string value);
 
+    /**
+     * \brief Parses a value for this spin option.
+     * \param value The value to parse.
+     * \param[out] result The parsed value, if it is valid.
+     * \return True if the value is an integer between the minimum and maximum value of the option, false otherwise.
+     */
+    bool parseSpinValue(const std::string& value, int& result);
+
     std::string toString();
 
     void addVar(std::string value);
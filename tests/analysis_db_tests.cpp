@@ -0,0 +1,147 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <filesystem>
+#include <string>
+
+#include "../src/analysis_db.h"
+#include "../src/constants.h"
+
+namespace Zagreus {
+static AnalysisRecord createRecord(const uint64_t key, const uint16_t depth, const uint64_t nodes) {
+    AnalysisRecord record{};
+
+    record.key = key;
+    record.verificationKey = key * 31 + 7;
+    record.depth = depth;
+    record.nodes = nodes;
+    record.score = static_cast<int32_t>(key % 200) - 100;
+    record.pvLength = 2;
+    record.pv[0] = encodeMove(E2, E4);
+    record.pv[1] = encodeMove(E7, E5);
+    return record;
+}
+
+TEST_CASE("test_AnalysisDatabaseStore", "[analysisdb]") {
+    const std::string path = (std::filesystem::temp_directory_path() / "zagreus_analysis_db_test.zadb").string();
+    std::filesystem::remove(path);
+    AnalysisDatabase database{};
+    AnalysisRecord record{};
+
+    REQUIRE(database.open(path));
+    REQUIRE(database.getRecordCount() == 0);
+    REQUIRE(database.store(createRecord(42, 10, 1000)));
+    REQUIRE(database.probe(42, createRecord(42, 0, 0).verificationKey, record));
+    REQUIRE(record.depth == 10);
+    REQUIRE(record.getBestMove() == encodeMove(E2, E4));
+
+    // A different verification key is a different position
+    REQUIRE_FALSE(database.probe(42, 1, record));
+
+    // Only deeper searches, or searches of the same depth with more nodes, replace a stored search
+    REQUIRE(database.store(createRecord(42, 8, 5000)));
+    REQUIRE(database.probe(42, createRecord(42, 0, 0).verificationKey, record));
+    REQUIRE(record.depth == 10);
+    REQUIRE(database.store(createRecord(42, 10, 2000)));
+    REQUIRE(database.probe(42, createRecord(42, 0, 0).verificationKey, record));
+    REQUIRE(record.nodes == 2000);
+    REQUIRE(database.getRecordCount() == 1);
+
+    // The table grows when it gets full, and the records are still there after opening the file again
+    for (uint64_t key = 1000; key < 1000 + ANALYSIS_DB_MIN_SLOTS; key++) {
+        REQUIRE(database.store(createRecord(key * 0x9E3779B97F4A7C15ULL, 5, key)));
+    }
+
+    database.close();
+    REQUIRE(database.open(path));
+    REQUIRE(database.getRecordCount() == ANALYSIS_DB_MIN_SLOTS + 1);
+
+    for (uint64_t key = 1000; key < 1000 + ANALYSIS_DB_MIN_SLOTS; key++) {
+        const AnalysisRecord expected = createRecord(key * 0x9E3779B97F4A7C15ULL, 5, key);
+
+        REQUIRE(database.probe(expected.key, expected.verificationKey, record));
+        REQUIRE(record.nodes == key);
+    }
+
+    database.close();
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("test_AnalysisDatabaseMerge", "[analysisdb]") {
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::string firstPath = (directory / "zagreus_analysis_db_first.zadb").string();
+    const std::string secondPath = (directory / "zagreus_analysis_db_second.zadb").string();
+    const std::string mergedPath = (directory / "zagreus_analysis_db_merged.zadb").string();
+    AnalysisRecord record{};
+
+    std::filesystem::remove(firstPath);
+    std::filesystem::remove(secondPath);
+
+    {
+        AnalysisDatabase first{};
+        AnalysisDatabase second{};
+
+        REQUIRE(first.open(firstPath));
+        REQUIRE(second.open(secondPath));
+        REQUIRE(first.store(createRecord(1, 12, 100)));
+        REQUIRE(first.store(createRecord(2, 4, 100)));
+        REQUIRE(second.store(createRecord(2, 9, 100)));
+        REQUIRE(second.store(createRecord(3, 7, 100)));
+    }
+
+    REQUIRE(AnalysisDatabase::merge(mergedPath, {firstPath, secondPath}));
+
+    AnalysisDatabase merged{};
+
+    REQUIRE(merged.open(mergedPath));
+    REQUIRE(merged.getRecordCount() == 3);
+    REQUIRE(merged.probe(1, createRecord(1, 0, 0).verificationKey, record));
+    REQUIRE(record.depth == 12);
+    REQUIRE(merged.probe(2, createRecord(2, 0, 0).verificationKey, record));
+    REQUIRE(record.depth == 9);
+    merged.close();
+
+    // Compacting is merging a database into itself
+    REQUIRE(AnalysisDatabase::merge(mergedPath, {mergedPath}));
+    REQUIRE(merged.open(mergedPath));
+    REQUIRE(merged.getRecordCount() == 3);
+    merged.close();
+
+    REQUIRE_FALSE(AnalysisDatabase::merge(mergedPath, {mergedPath + ".missing"}));
+
+    for (const std::string& path : {firstPath, secondPath, mergedPath}) {
+        std::filesystem::remove(path);
+    }
+}
+
+TEST_CASE("test_AnalysisDatabaseMateScores", "[analysisdb]") {
+    // Mate 10 plies after a position at game ply 30
+    const int mateScore = MATE_SCORE - 40;
+    const int storedScore = scoreToAnalysisDB(mateScore, 30);
+
+    REQUIRE(storedScore == MATE_SCORE - 10);
+    // The same position at game ply 60 is mate at game ply 70
+    REQUIRE(scoreFromAnalysisDB(storedScore, 60) == MATE_SCORE - 70);
+    REQUIRE(scoreFromAnalysisDB(scoreToAnalysisDB(-mateScore, 30), 30) == -mateScore);
+    REQUIRE(scoreFromAnalysisDB(scoreToAnalysisDB(150, 30), 90) == 150);
+}
+} // namespace Zagreus
@@ -0,0 +1,156 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../src/bitboard.h"
+#include "../src/board.h"
+#include "../src/book.h"
+#include "../src/magics.h"
+
+namespace Zagreus {
+static void writeBook(const std::string& path, std::vector<PolyglotEntry> entries) {
+    std::ranges::sort(entries, {}, &PolyglotEntry::key);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    for (const PolyglotEntry& entry : entries) {
+        const uint64_t fields[] = {entry.key, entry.move, entry.weight, entry.learn};
+        const int sizes[] = {8, 2, 2, 4};
+
+        for (int field = 0; field < 4; field++) {
+            for (int byte = sizes[field] - 1; byte >= 0; byte--) {
+                file.put(static_cast<char>(fields[field] >> (byte * 8) & 0xFF));
+            }
+        }
+    }
+}
+
+// Encodes a move the way Polyglot does: to square in bits 0-5, from square in bits 6-11, promotion in bits 12-14
+static uint16_t getPolyglotMove(const std::string& notation, const int promotion = 0) {
+    const Move move = getMoveFromMoveNotation(notation);
+    return static_cast<uint16_t>(getToSquare(move) | getFromSquare(move) << 6 | promotion << 12);
+}
+
+TEST_CASE("test_PolyglotKey", "[book]") {
+    initZobristConstants();
+    initializeMagicBitboards();
+    initializeAttackLookupTables();
+
+    // The test positions of the Polyglot book format specification
+    const std::vector<std::pair<std::string, uint64_t>> positions = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0x463B96181691FC9C},
+        {"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823C9B50FD114196},
+        {"rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756B94461C50FB0},
+        {"rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662FAFB965DB29D4},
+        {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22A48B5A8E47FF78},
+        {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652A607CA3F242C1},
+        {"rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00FDD303C946BDD9},
+        {"rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3C8123EA7B067637},
+        {"rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5C3F9B829B279560},
+    };
+
+    for (const auto& [fen, expectedKey] : positions) {
+        Board board{};
+
+        INFO(fen);
+        REQUIRE(board.setFromFEN(fen));
+        REQUIRE(getPolyglotKey(board) == expectedKey);
+    }
+}
+
+TEST_CASE("test_OpeningBook", "[book]") {
+    initZobristConstants();
+    initializeMagicBitboards();
+    initializeAttackLookupTables();
+    initializeBetweenLookupTable();
+
+    const std::string path = (std::filesystem::temp_directory_path() / "zagreus_book_test.bin").string();
+    const std::string castlingFEN = "r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1";
+    const std::string promotionFEN = "8/1P6/8/8/8/8/8/k6K w - - 0 1";
+    Board board{};
+
+    REQUIRE(board.setFromFEN(castlingFEN));
+    const uint64_t castlingKey = getPolyglotKey(board);
+    REQUIRE(board.setFromFEN(promotionFEN));
+    const uint64_t promotionKey = getPolyglotKey(board);
+    REQUIRE(board.setFromFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"));
+    const uint64_t startKey = getPolyglotKey(board);
+
+    writeBook(path, {
+                  {startKey, getPolyglotMove("e2e4"), 3, 0},
+                  {startKey, getPolyglotMove("e2e5"), 100, 0},
+                  {startKey, getPolyglotMove("d2d4"), 1, 0},
+                  {castlingKey, getPolyglotMove("e1h1"), 1, 0},
+                  {castlingKey, getPolyglotMove("e1a1"), 1, 0},
+                  {promotionKey, getPolyglotMove("b7b8", 1), 1, 0},
+              });
+
+    OpeningBook book{};
+
+    REQUIRE(book.open(path));
+    REQUIRE(book.getEntryCount() == 6);
+
+    // The illegal move is left out
+    std::vector<BookMove> moves = book.getMoves(board);
+    REQUIRE(moves.size() == 2);
+    REQUIRE(getMoveNotation(moves[0].move) == "e2e4");
+    REQUIRE(moves[0].weight == 3);
+    REQUIRE(getMoveNotation(moves[1].move) == "d2d4");
+
+    for (int i = 0; i < 20; i++) {
+        Move move = NO_MOVE;
+
+        REQUIRE(book.probe(board, move));
+        REQUIRE((getMoveNotation(move) == "e2e4" || getMoveNotation(move) == "d2d4"));
+    }
+
+    // Polyglot castling moves are king captures rook
+    REQUIRE(board.setFromFEN(castlingFEN));
+    moves = book.getMoves(board);
+    REQUIRE(moves.size() == 2);
+    REQUIRE(std::ranges::count(moves, encodeMove(E1, G1, CASTLING), &BookMove::move) == 1);
+    REQUIRE(std::ranges::count(moves, encodeMove(E1, C1, CASTLING), &BookMove::move) == 1);
+
+    REQUIRE(board.setFromFEN(promotionFEN));
+    moves = book.getMoves(board);
+    REQUIRE(moves.size() == 1);
+    REQUIRE(getMoveNotation(moves[0].move) == "b7b8n");
+
+    Move move = NO_MOVE;
+    REQUIRE(board.setFromFEN("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1"));
+    REQUIRE_FALSE(book.probe(board, move));
+
+    book.close();
+    REQUIRE_FALSE(book.isOpen());
+    REQUIRE(book.getMoves(board).empty());
+
+    // A file that is not a list of entries is rejected
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << "not a book";
+    REQUIRE_FALSE(book.open(path));
+    REQUIRE_FALSE(book.open(path + ".missing"));
+    std::filesystem::remove(path);
+}
+} // namespace Zagreus
@@ -22,6 +22,7 @@
 
 #include "../src/board.h"
 #include "../src/eval.h"
+#include "../src/eval_cache.h"
 #include "../src/move_gen.h"
 #include "../src/move_picker.h"
 
@@ -77,4 +78,32 @@ const std::vector<std::string> POSITIONS = {
     "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
     "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124"
 };
+
+TEST_CASE("test_EvalCache", "[eval]") {
+    EvalCache evalCache{};
+    int eval = 0;
+
+    // A disabled cache never stores anything
+    evalCache.store(0xABCD0000ULL, 10);
+    REQUIRE_FALSE(evalCache.probe(0xABCD0000ULL, eval));
+
+    evalCache.resize(1);
+    REQUIRE_FALSE(evalCache.probe(0xABCD0000ULL, eval));
+
+    evalCache.store(0xABCD0000ULL, -1234);
+    REQUIRE(evalCache.probe(0xABCD0000ULL, eval));
+    REQUIRE(eval == -1234);
+
+    // Same index, different position
+    REQUIRE_FALSE(evalCache.probe(0xABCD0000ULL ^ (1ULL << 60), eval));
+
+    // A new position replaces the old one at the same index
+    evalCache.store(0xABCD0000ULL ^ (1ULL << 60), 77);
+    REQUIRE_FALSE(evalCache.probe(0xABCD0000ULL, eval));
+    REQUIRE(evalCache.probe(0xABCD0000ULL ^ (1ULL << 60), eval));
+    REQUIRE(eval == 77);
+
+    evalCache.clear();
+    REQUIRE_FALSE(evalCache.probe(0xABCD0000ULL ^ (1ULL << 60), eval));
+}
 } // namespace Zagreus
@@ -0,0 +1,199 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/bitboard.h"
+#include "../src/board.h"
+#include "../src/cpu.h"
+#include "../src/magics.h"
+#include "../src/move_gen.h"
+#include "../src/nnue.h"
+
+namespace Zagreus {
+// Writes a network with random weights that are small enough to never overflow the accumulator
+static void writeRandomNetwork(const std::string& path, const NNUEFileHeader& header) {
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> weightDistribution(-64, 64);
+    std::uniform_int_distribution<int> outputDistribution(-127, 127);
+    std::vector<int16_t> featureWeights(NNUE_INPUT_SIZE * NNUE_HIDDEN_SIZE);
+    std::vector<int16_t> featureBiases(NNUE_HIDDEN_SIZE);
+    std::vector<int8_t> outputWeights(COLORS * NNUE_HIDDEN_SIZE);
+    const int32_t outputBias = 1234;
+
+    for (int16_t& weight : featureWeights) {
+        weight = static_cast<int16_t>(weightDistribution(random));
+    }
+
+    for (int16_t& bias : featureBiases) {
+        bias = static_cast<int16_t>(weightDistribution(random));
+    }
+
+    for (int8_t& weight : outputWeights) {
+        weight = static_cast<int8_t>(outputDistribution(random));
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(featureWeights.data()), featureWeights.size() * sizeof(int16_t));
+    file.write(reinterpret_cast<const char*>(featureBiases.data()), featureBiases.size() * sizeof(int16_t));
+    file.write(reinterpret_cast<const char*>(outputWeights.data()), outputWeights.size());
+    file.write(reinterpret_cast<const char*>(&outputBias), sizeof(outputBias));
+}
+
+static void setupNNUETest() {
+    const std::string path = (std::filesystem::temp_directory_path() / "zagreus_nnue_test.bin").string();
+
+    initZobristConstants();
+    initializeMagicBitboards();
+    initializeAttackLookupTables();
+    initializeBetweenLookupTable();
+    writeRandomNetwork(path, NNUEFileHeader{});
+    REQUIRE(loadNetwork(path));
+    std::filesystem::remove(path);
+}
+
+// Compares the incrementally updated evaluation with one computed from scratch in every position of the tree
+static void verifyAccumulators(Board& board, AccumulatorStack& stack, const int depth) {
+    auto accumulator = std::make_unique<Accumulator>();
+
+    refreshAccumulator(board, *accumulator);
+    REQUIRE(evaluateNNUE(board, stack) == forwardNetworkScalar(*accumulator, board.getSideToMove()));
+    REQUIRE(forwardNetwork(*accumulator, board.getSideToMove())
+            == forwardNetworkScalar(*accumulator, board.getSideToMove()));
+
+    if (depth == 0) {
+        return;
+    }
+
+    MoveList moveList{};
+    const PieceColor sideToMove = board.getSideToMove();
+
+    if (sideToMove == WHITE) {
+        generateMoves<WHITE, ALL>(board, moveList);
+    } else {
+        generateMoves<BLACK, ALL>(board, moveList);
+    }
+
+    for (int i = 0; i < moveList.size; i++) {
+        board.makeMove(moveList.moves[i]);
+        verifyAccumulators(board, stack, depth - 1);
+        board.unmakeMove();
+    }
+
+    board.makeNullMove();
+    verifyAccumulators(board, stack, 0);
+    board.unmakeNullMove();
+}
+
+TEST_CASE("test_NNUELoadNetwork", "[nnue]") {
+    const std::string path = (std::filesystem::temp_directory_path() / "zagreus_nnue_load_test.bin").string();
+    NNUEFileHeader header{};
+
+    writeRandomNetwork(path, header);
+    REQUIRE(loadNetwork(path));
+    REQUIRE(isNetworkLoaded());
+
+    // A file that is too short is rejected
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    REQUIRE_FALSE(loadNetwork(path));
+
+    // A network of a different version is rejected
+    header.version = NNUE_FILE_VERSION + 1;
+    writeRandomNetwork(path, header);
+    REQUIRE_FALSE(loadNetwork(path));
+
+    header = NNUEFileHeader{};
+    header.hiddenSize = NNUE_HIDDEN_SIZE * 2;
+    writeRandomNetwork(path, header);
+    REQUIRE_FALSE(loadNetwork(path));
+
+    REQUIRE_FALSE(loadNetwork(path + ".missing"));
+    REQUIRE(isNetworkLoaded());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("test_NNUEIncrementalAccumulator", "[nnue]") {
+    const std::vector<std::string> fens = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+    };
+    auto stack = std::make_unique<AccumulatorStack>();
+    Board board{};
+
+    setupNNUETest();
+    board.setAccumulatorStack(stack.get());
+
+    for (const std::string& fen : fens) {
+        REQUIRE(board.setFromFEN(fen));
+        verifyAccumulators(board, *stack, 2);
+    }
+
+    board.setAccumulatorStack(nullptr);
+}
+
+TEST_CASE("test_NNUEInstructionSets", "[nnue]") {
+    auto stack = std::make_unique<AccumulatorStack>();
+    const InstructionSet detectedInstructionSet = detectInstructionSet();
+    Board board{};
+
+    setupNNUETest();
+    board.setAccumulatorStack(stack.get());
+
+    // The kernels of every supported instruction set have to give the same results as the scalar kernels
+    for (int instructionSet = SCALAR; instructionSet <= detectedInstructionSet; ++instructionSet) {
+        setNNUEInstructionSet(static_cast<InstructionSet>(instructionSet));
+        REQUIRE(getNNUEInstructionSet() == instructionSet);
+        REQUIRE(board.setFromFEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10"));
+        verifyAccumulators(board, *stack, 1);
+    }
+
+    // An instruction set the CPU does not support is never selected
+    setNNUEInstructionSet(AVX2);
+    REQUIRE(getNNUEInstructionSet() == detectedInstructionSet);
+    board.setAccumulatorStack(nullptr);
+}
+
+TEST_CASE("test_NNUESymmetry", "[nnue]") {
+    auto stack = std::make_unique<AccumulatorStack>();
+    Board board{};
+    Board mirroredBoard{};
+    auto mirroredStack = std::make_unique<AccumulatorStack>();
+
+    setupNNUETest();
+    board.setAccumulatorStack(stack.get());
+    mirroredBoard.setAccumulatorStack(mirroredStack.get());
+
+    // Both perspectives see the same position, so the evaluation of the side to move is the same
+    REQUIRE(board.setFromFEN("r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3"));
+    REQUIRE(mirroredBoard.setFromFEN("rnbqkb1r/pppp1ppp/5n2/4p3/4P3/2N5/PPPP1PPP/R1BQKBNR b KQkq - 2 3"));
+    REQUIRE(evaluateNNUE(board, *stack) == evaluateNNUE(mirroredBoard, *mirroredStack));
+}
+} // namespace Zagreus
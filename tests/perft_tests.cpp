@@ -44,6 +44,7 @@ TEST_CASE("test_Perft", "[perft]") {
     initZobristConstants();
     initializeMagicBitboards();
     initializeAttackLookupTables();
+    initializeBetweenLookupTable();
 
     for (const auto& [fen, depth, expectedNodes] : POSITIONS) {
         Board board{};
@@ -56,4 +57,73 @@ TEST_CASE("test_Perft", "[perft]") {
         REQUIRE(actualNodes == expectedNodes);
     }
 }
+
+TEST_CASE("test_ParallelPerft", "[perft]") {
+    Engine engine{};
+
+    initZobristConstants();
+    initializeMagicBitboards();
+    initializeAttackLookupTables();
+    initializeBetweenLookupTable();
+
+    for (const auto& [fen, depth, expectedNodes] : POSITIONS) {
+        Board board{};
+
+        board.setFromFEN(fen);
+        const uint64_t zobristHash = board.getZobristHash();
+
+        // Depth 2 splits at the root moves, deeper searches split at the replies
+        for (const int searchDepth : {2, depth}) {
+            const uint64_t serialNodes = perft(board, searchDepth, false);
+            const uint64_t parallelNodes = perft(board, searchDepth, false, 3);
+
+            CAPTURE(fen, searchDepth, serialNodes, parallelNodes);
+            REQUIRE(parallelNodes == serialNodes);
+        }
+
+        REQUIRE(board.getZobristHash() == zobristHash);
+    }
+}
+
+TEST_CASE("test_PerftTable", "[perft]") {
+    Engine engine{};
+
+    initZobristConstants();
+    initializeMagicBitboards();
+    initializeAttackLookupTables();
+    initializeBetweenLookupTable();
+
+    // A 1 MB table is small enough that entries are replaced and collide all the time
+    PerftTable table{1};
+
+    for (const auto& [fen, depth, expectedNodes] : POSITIONS) {
+        Board board{};
+
+        board.setFromFEN(fen);
+
+        for (const int threadCount : {1, 3}) {
+            const uint64_t actualNodes = perft(board, depth, false, threadCount, &table);
+
+            CAPTURE(fen, depth, threadCount, expectedNodes, actualNodes);
+            REQUIRE(actualNodes == static_cast<uint64_t>(expectedNodes));
+        }
+    }
+
+    REQUIRE(table.getHits() > 0);
+    REQUIRE(table.getHits() <= table.getProbes());
+}
+
+TEST_CASE("test_ParsePerftSuiteLine", "[perft]") {
+    PerftSuiteEntry entry{};
+
+    REQUIRE(parsePerftSuiteLine("4k3/8/8/8/8/8/8/4K2R w K - 0 1 ;D1 15 ;D2 66 ;D6 764643\r", entry));
+    REQUIRE(entry.fen == "4k3/8/8/8/8/8/8/4K2R w K - 0 1");
+    REQUIRE(entry.depths == std::vector<std::pair<int, uint64_t>>{{1, 15}, {2, 66}, {6, 764643}});
+
+    REQUIRE_FALSE(parsePerftSuiteLine("4k3/8/8/8/8/8/8/4K2R w K - 0 1", entry));
+    REQUIRE_FALSE(parsePerftSuiteLine("4k3/8/8/8/8/8/8/4K2R w K - 0 1 ;D1", entry));
+    REQUIRE_FALSE(parsePerftSuiteLine("4k3/8/8/8/8/8/8/4K2R w K - 0 1 ;X1 15", entry));
+    REQUIRE_FALSE(parsePerftSuiteLine("4k3/8/8/8/8/8/8/4K2R w K - 0 1 ;D0 1", entry));
+    REQUIRE_FALSE(parsePerftSuiteLine(" ;D1 20", entry));
+}
 } // namespace Zagreus
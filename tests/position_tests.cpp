@@ -21,8 +21,11 @@
 #include "catch2/catch_test_macros.hpp"
 
 #include "../src/board.h"
+#include "../src/eval_features.h"
+#include "../src/magics.h"
 #include "../src/move_gen.h"
 #include "../src/move_picker.h"
+#include "../src/pst.h"
 
 namespace Zagreus {
 
@@ -81,6 +84,7 @@ TEST_CASE("test_PieceBitBoards", "[types]") {
     Board board{};
     initZobristConstants();
     initializeAttackLookupTables();
+    initializeBetweenLookupTable();
 
     for (const std::string& fen : POSITIONS) {
         board.setFromFEN(fen);
@@ -135,4 +139,257 @@ TEST_CASE("test_PieceBitBoards", "[types]") {
         }
     }
 }
+
+template <PieceColor color>
+static void checkZobristHashAfterMove(Board& board, const std::string& fen, const int depth) {
+    MoveList moves{};
+    generateMoves<color, ALL>(board, moves);
+
+    for (int i = 0; i < moves.size; ++i) {
+        const Move move = moves.moves[i];
+        const uint64_t expectedHash = board.getZobristHashAfterMove(move);
+
+        board.makeMove(move);
+
+        CAPTURE(fen, getMoveNotation(move));
+        REQUIRE(board.getZobristHash() == expectedHash);
+
+        if (depth > 1) {
+            checkZobristHashAfterMove<!color>(board, fen, depth - 1);
+        }
+
+        board.unmakeMove();
+    }
+}
+
+TEST_CASE("test_ZobristHashAfterMove", "[board]") {
+    Board board{};
+    std::vector<std::string> positions = POSITIONS;
+
+    initZobristConstants();
+    initializeMagicBitboards();
+    initializeAttackLookupTables();
+    initializeBetweenLookupTable();
+
+    // Castling, en passant and promotions with captures
+    positions.emplace_back("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
+    positions.emplace_back("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    positions.emplace_back("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3");
+
+    for (const std::string& fen : positions) {
+        board.setFromFEN(fen);
+
+        if (board.getSideToMove() == WHITE) {
+            checkZobristHashAfterMove<WHITE>(board, fen, 2);
+        } else {
+            checkZobristHashAfterMove<BLACK>(board, fen, 2);
+        }
+    }
+}
+
+// Places the pieces of the given board on an empty board, so the incrementally updated state is computed from scratch
+static void copyPieces(const Board& board, Board& target, const bool pawnsOnly) {
+    target.reset();
+
+    for (uint8_t square = 0; square < SQUARES; ++square) {
+        const Piece piece = board.getPieceOnSquare(square);
+
+        if (piece != EMPTY && (!pawnsOnly || getPieceType(piece) == PAWN)) {
+            target.setPiece(piece, square);
+        }
+    }
+}
+
+// The pawn hash of a board that only contains the pawns of the given board, computed from scratch
+static uint64_t getPawnOnlyHash(const Board& board) {
+    Board pawnBoard{};
+
+    copyPieces(board, pawnBoard, true);
+    return pawnBoard.getZobristHash();
+}
+
+template <PieceColor color>
+static void checkPawnZobristHash(Board& board, const std::string& fen, const int depth) {
+    MoveList moves{};
+    generateMoves<color, ALL>(board, moves);
+
+    for (int i = 0; i < moves.size; ++i) {
+        const Move move = moves.moves[i];
+        const uint64_t pawnHashBefore = board.getPawnZobristHash();
+
+        board.makeMove(move);
+
+        CAPTURE(fen, getMoveNotation(move));
+        REQUIRE(board.getPawnZobristHash() == getPawnOnlyHash(board));
+
+        if (depth > 1) {
+            checkPawnZobristHash<!color>(board, fen, depth - 1);
+        }
+
+        board.unmakeMove();
+        REQUIRE(board.getPawnZobristHash() == pawnHashBefore);
+    }
+}
+
+TEST_CASE("test_PawnZobristHash", "[board]") {
+    Board board{};
+    std::vector<std::string> positions = POSITIONS;
+
+    initZobristConstants();
+    initializeMagicBitboards();
+    initializeAttackLookupTables();
+    initializeBetweenLookupTable();
+
+    // En passant and promotions with captures
+    positions.emplace_back("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    positions.emplace_back("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3");
+
+    for (const std::string& fen : positions) {
+        board.setFromFEN(fen);
+        REQUIRE(board.getPawnZobristHash() == getPawnOnlyHash(board));
+
+        if (board.getSideToMove() == WHITE) {
+            checkPawnZobristHash<WHITE>(board, fen, 2);
+        } else {
+            checkPawnZobristHash<BLACK>(board, fen, 2);
+        }
+    }
+}
+
+template <PieceColor color>
+static void checkIncrementalScores(Board& board, const std::string& fen, const int depth) {
+    MoveList moves{};
+    Board scratchBoard{};
+    generateMoves<color, ALL>(board, moves);
+
+    for (int i = 0; i < moves.size; ++i) {
+        const Move move = moves.moves[i];
+
+        board.makeMove(move);
+        copyPieces(board, scratchBoard, false);
+
+        CAPTURE(fen, getMoveNotation(move));
+        REQUIRE(board.getPstScore(WHITE) == scratchBoard.getPstScore(WHITE));
+        REQUIRE(board.getPstScore(BLACK) == scratchBoard.getPstScore(BLACK));
+        REQUIRE(board.getPhaseMaterial() == scratchBoard.getPhaseMaterial());
+
+        if (depth > 1) {
+            checkIncrementalScores<!color>(board, fen, depth - 1);
+        }
+
+        board.unmakeMove();
+    }
+}
+
+TEST_CASE("test_PstTableFilledBeforeSetup", "[board]") {
+    Board board{};
+
+    // No initializePst call, like a position command that is sent before isready
+    initZobristConstants();
+
+    REQUIRE(board.setFromFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"));
+
+    for (const std::string& move : {"e2e4", "e7e5", "g1f3"}) {
+        board.makeMove(getMoveFromMoveNotation(move));
+    }
+
+    Score scores[COLORS]{};
+
+    for (Square square = A1; square <= H8; square++) {
+        const Piece piece = board.getPieceOnSquare(square);
+
+        if (piece == EMPTY) {
+            continue;
+        }
+
+        const PieceType pieceType = getPieceType(piece);
+        const int tableSquare = getPieceColor(piece) == WHITE ? square ^ 56 : square;
+
+        scores[getPieceColor(piece)] += evalMaterialValues[pieceType] + makeScore(
+            getMidgameTable(pieceType)[tableSquare], getEndgameTable(pieceType)[tableSquare]);
+    }
+
+    REQUIRE(board.getPstScore(WHITE) == scores[WHITE]);
+    REQUIRE(board.getPstScore(BLACK) == scores[BLACK]);
+    REQUIRE(board.getPhaseMaterial() == TOTAL_PHASE);
+}
+
+TEST_CASE("test_IncrementalScores", "[board]") {
+    Board board{};
+    std::vector<std::string> positions = POSITIONS;
+
+    initZobristConstants();
+    initializeMagicBitboards();
+    initializeAttackLookupTables();
+    initializeBetweenLookupTable();
+    initializePst();
+
+    // Castling, en passant and promotions with captures
+    positions.emplace_back("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    positions.emplace_back("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3");
+
+    board.setFromFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    REQUIRE(board.getPhaseMaterial() == TOTAL_PHASE);
+    REQUIRE(getMidgameScore(board.getPstScore(WHITE)) > 0);
+    REQUIRE(getEndgameScore(board.getPstScore(WHITE)) > 0);
+
+    for (const std::string& fen : positions) {
+        board.setFromFEN(fen);
+
+        const Score score = board.getPstScore(WHITE) - board.getPstScore(BLACK);
+        const int phaseMaterial = board.getPhaseMaterial();
+
+        if (board.getSideToMove() == WHITE) {
+            checkIncrementalScores<WHITE>(board, fen, 2);
+        } else {
+            checkIncrementalScores<BLACK>(board, fen, 2);
+        }
+
+        // Unmaking all moves restores the sums
+        REQUIRE(board.getPstScore(WHITE) - board.getPstScore(BLACK) == score);
+        REQUIRE(board.getPhaseMaterial() == phaseMaterial);
+    }
+}
+
+static void makeMoves(Board& board, const std::vector<std::string>& moves) {
+    for (const std::string& move : moves) {
+        board.makeMove(getMoveFromMoveNotation(move));
+    }
+}
+
+TEST_CASE("test_Repetition", "[board]") {
+    Board board{};
+
+    initZobristConstants();
+    initializeMagicBitboards();
+    initializeAttackLookupTables();
+    initializeBetweenLookupTable();
+
+    REQUIRE(board.setFromFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"));
+    makeMoves(board, {"e2e4", "e7e5", "g1f3", "g8f6", "f3g1"});
+    REQUIRE_FALSE(board.isDraw());
+
+    // Black can repeat the position after e7e5, but only a position after the root counts
+    REQUIRE(board.hasUpcomingRepetition(4));
+    REQUIRE_FALSE(board.hasUpcomingRepetition(3));
+
+    makeMoves(board, {"f6g8"});
+    REQUIRE(board.isDraw());
+    // White can repeat as well now, moving the knight back to f3
+    REQUIRE(board.hasUpcomingRepetition(6));
+
+    // A capture or pawn move makes the earlier positions unreachable
+    makeMoves(board, {"d2d4"});
+    REQUIRE_FALSE(board.isDraw());
+    REQUIRE_FALSE(board.hasUpcomingRepetition(7));
+
+    // The queen went around the knight, so it can't go straight back to d8
+    REQUIRE(board.setFromFEN("k2q4/3N4/8/8/8/8/8/7K w - - 0 1"));
+    makeMoves(board, {"h1h2", "d8b6", "h2g2", "b6d6", "g2h1"});
+    REQUIRE_FALSE(board.hasUpcomingRepetition(6));
+
+    REQUIRE(board.setFromFEN("k2q4/8/8/8/8/8/8/7K w - - 0 1"));
+    makeMoves(board, {"h1h2", "d8b6", "h2g2", "b6d6", "g2h1"});
+    REQUIRE(board.hasUpcomingRepetition(6));
+}
 } // namespace Zagreus
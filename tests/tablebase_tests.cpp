@@ -0,0 +1,307 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/bitboard.h"
+#include "../src/board.h"
+#include "../src/magics.h"
+#include "../src/move_gen.h"
+#include "../src/tablebase.h"
+
+namespace Zagreus {
+static const std::string tablebaseDir = (std::filesystem::temp_directory_path() / "zagreus_tb_test").string();
+
+// Generates the tables of up to 3 pieces once, as every test needs them
+static Tablebases& getGeneratedTablebases() {
+    static Tablebases tablebases{};
+
+    if (tablebases.getTableCount() == 0) {
+        initZobristConstants();
+        initializeMagicBitboards();
+        initializeBetweenLookupTable();
+        initializeAttackLookupTables();
+        std::filesystem::remove_all(tablebaseDir);
+        REQUIRE(tablebases.generateTables(tablebaseDir, 3, 4));
+    }
+
+    return tablebases;
+}
+
+static TBResult lookupBoard(const Tablebases& tablebases, const Board& board) {
+    std::vector<Piece> pieces{};
+    std::vector<uint8_t> squares{};
+    uint64_t occupied = board.getOccupiedBitboard();
+
+    while (occupied) {
+        const uint8_t square = popLsb(occupied);
+
+        pieces.push_back(board.getPieceOnSquare(square));
+        squares.push_back(square);
+    }
+
+    return tablebases.lookup(pieces.data(), squares.data(), static_cast<int>(pieces.size()), board.getSideToMove());
+}
+
+// Checks that the result of a position follows from the results of its children, like a perft of depth 1
+template <PieceColor color>
+static void checkChildren(const Tablebases& tablebases, Board& board, const TBResult result) {
+    MoveList moves{};
+    bool hasLosingChild = false;
+    bool allChildrenWin = true;
+    int legalMoves = 0;
+
+    generateMoves<color, ALL>(board, moves);
+
+    for (int i = 0; i < moves.size; i++) {
+        board.makeMove(moves.moves[i]);
+
+        const TBResult childResult = lookupBoard(tablebases, board);
+
+        REQUIRE(childResult != TB_INVALID);
+        legalMoves += 1;
+        hasLosingChild |= childResult == TB_LOSS;
+        allChildrenWin &= childResult == TB_WIN;
+
+        board.unmakeMove();
+    }
+
+    if (legalMoves == 0) {
+        REQUIRE(result == (board.isKingInCheck<color>() ? TB_LOSS : TB_DRAW));
+    } else if (hasLosingChild) {
+        REQUIRE(result == TB_WIN);
+    } else if (allChildrenWin) {
+        REQUIRE(result == TB_LOSS);
+    } else {
+        REQUIRE(result == TB_DRAW);
+    }
+}
+
+static std::string getFEN(const std::vector<std::pair<char, uint8_t>>& pieces, const PieceColor sideToMove) {
+    std::string fen{};
+
+    for (int rank = 7; rank >= 0; rank--) {
+        int emptySquares = 0;
+
+        for (int file = 0; file < 8; file++) {
+            const auto iterator = std::ranges::find(pieces, rank * 8 + file, &std::pair<char, uint8_t>::second);
+
+            if (iterator == pieces.end()) {
+                emptySquares += 1;
+                continue;
+            }
+
+            if (emptySquares > 0) {
+                fen += std::to_string(emptySquares);
+                emptySquares = 0;
+            }
+
+            fen += iterator->first;
+        }
+
+        if (emptySquares > 0) {
+            fen += std::to_string(emptySquares);
+        }
+
+        fen += rank > 0 ? "/" : "";
+    }
+
+    return fen + (sideToMove == WHITE ? " w" : " b") + " - - 0 1";
+}
+
+TEST_CASE("test_TablebaseNames", "[tablebase]") {
+    const std::vector<std::string> threePieceNames = Tablebases::getTableNames(3);
+    const std::vector<std::string> fourPieceNames = Tablebases::getTableNames(4);
+
+    REQUIRE(threePieceNames == std::vector<std::string>{"KQvK", "KRvK", "KBvK", "KNvK", "KPvK"});
+    REQUIRE(fourPieceNames.size() == 35);
+    REQUIRE(std::ranges::find(fourPieceNames, "KQvKR") != fourPieceNames.end());
+    REQUIRE(std::ranges::find(fourPieceNames, "KRvKQ") == fourPieceNames.end());
+    // Promotions lead to tables with fewer pawns, which have to be generated first
+    REQUIRE(std::ranges::find(fourPieceNames, "KQvKP") < std::ranges::find(fourPieceNames, "KPvKP"));
+    REQUIRE(fourPieceNames.back() == "KPPvK");
+}
+
+TEST_CASE("test_TablebaseKnownPositions", "[tablebase]") {
+    const Tablebases& tablebases = getGeneratedTablebases();
+    const std::vector<std::pair<std::string, TBResult>> positions = {
+        {"4k3/4P3/4K3/8/8/8/8/8 w - - 0 1", TB_WIN},
+        {"4k3/4P3/4K3/8/8/8/8/8 b - - 0 1", TB_DRAW},
+        {"8/8/8/4k3/8/4K3/4P3/8 w - - 0 1", TB_DRAW},
+        {"8/8/8/4k3/8/4K3/4P3/8 b - - 0 1", TB_LOSS},
+        {"8/4p3/4k3/8/4K3/8/8/8 b - - 0 1", TB_DRAW},
+        {"8/4p3/4k3/8/4K3/8/8/8 w - - 0 1", TB_LOSS},
+        {"k7/8/8/8/8/8/8/R6K b - - 0 1", TB_LOSS},
+        {"K7/8/8/8/8/8/8/r6k w - - 0 1", TB_LOSS},
+        {"k7/8/1Q6/8/8/8/8/7K b - - 0 1", TB_DRAW},
+        {"k7/8/1Q6/8/8/8/8/7K w - - 0 1", TB_WIN},
+        {"8/8/8/8/8/8/1k6/Q6K b - - 0 1", TB_DRAW},
+        {"8/8/8/3k4/8/8/3N4/3K4 w - - 0 1", TB_DRAW},
+    };
+
+    for (const auto& [fen, expectedResult] : positions) {
+        Board board{};
+        TBResult result = TB_INVALID;
+
+        INFO(fen);
+        REQUIRE(board.setFromFEN(fen));
+        REQUIRE(tablebases.probe(board, result));
+        REQUIRE(result == expectedResult);
+    }
+
+    Board board{};
+    TBResult result = TB_INVALID;
+
+    // Castling rights are not in the tables, and neither is a position with too many pieces
+    REQUIRE(board.setFromFEN("4k3/8/8/8/8/8/8/R3K3 w Q - 0 1"));
+    REQUIRE_FALSE(tablebases.probe(board, result));
+    REQUIRE(board.setFromFEN("4k3/8/8/8/8/8/8/RR2K3 w - - 0 1"));
+    REQUIRE_FALSE(tablebases.probe(board, result));
+}
+
+TEST_CASE("test_TablebaseConsistency", "[tablebase]") {
+    const Tablebases& tablebases = getGeneratedTablebases();
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> squareDistribution(0, 63);
+
+    for (const char extraPiece : {'Q', 'R', 'B', 'N', 'P', 'q', 'p'}) {
+        int checkedPositions = 0;
+
+        while (checkedPositions < 1000) {
+            const std::vector<std::pair<char, uint8_t>> pieces = {
+                {'K', squareDistribution(random)}, {'k', squareDistribution(random)},
+                {extraPiece, squareDistribution(random)}};
+            const PieceColor sideToMove = squareDistribution(random) % 2 == 0 ? WHITE : BLACK;
+            const bool isPawnOnLastRank = (extraPiece == 'P' || extraPiece == 'p')
+                                          && (pieces[2].second < 8 || pieces[2].second >= 56);
+
+            if (pieces[0].second == pieces[1].second || pieces[0].second == pieces[2].second
+                || pieces[1].second == pieces[2].second || isPawnOnLastRank) {
+                continue;
+            }
+
+            Board board{};
+
+            REQUIRE(board.setFromFEN(getFEN(pieces, sideToMove)));
+
+            // The side that just moved can't be in check
+            if ((sideToMove == WHITE && !board.isPositionLegal<BLACK>())
+                || (sideToMove == BLACK && !board.isPositionLegal<WHITE>())) {
+                continue;
+            }
+
+            const TBResult result = lookupBoard(tablebases, board);
+
+            INFO(getFEN(pieces, sideToMove));
+            REQUIRE(result != TB_INVALID);
+
+            if (sideToMove == WHITE) {
+                checkChildren<WHITE>(tablebases, board, result);
+            } else {
+                checkChildren<BLACK>(tablebases, board, result);
+            }
+
+            checkedPositions += 1;
+        }
+    }
+}
+
+// Writes a table that is won for white, which is the side with the promoted piece once lookups swap colors
+static void writePromotionWinsTable(const std::string& directory, const std::string& name) {
+    TBFileHeader header{};
+
+    header.pieceCount = 4;
+    header.entryCount = 2ULL * 32 * SQUARES * SQUARES * SQUARES;
+
+    std::vector<uint8_t> data(header.entryCount / 4, 0b10101010);
+    std::ofstream file(std::filesystem::path(directory) / (name + ".zwdl"), std::ios::binary | std::ios::trunc);
+
+    // White to move comes first, 2 bits per position
+    std::fill_n(data.begin(), data.size() / 2, 0b01010101);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+}
+
+TEST_CASE("test_TablebaseEnPassant", "[tablebase]") {
+    getGeneratedTablebases();
+    const std::string stubDir = tablebaseDir + "_en_passant";
+    Tablebases tablebases{};
+
+    // Generating the real promotion tables takes minutes, so promoting is stubbed to win. The positions below keep
+    // their real result with the stubs.
+    std::filesystem::remove_all(stubDir);
+    std::filesystem::create_directories(stubDir);
+
+    for (const std::string name : {"KQvKP", "KRvKP", "KBvKP", "KNvKP"}) {
+        writePromotionWinsTable(stubDir, name);
+    }
+
+    REQUIRE(tablebases.loadTables(tablebaseDir) == 5);
+    REQUIRE(tablebases.loadTables(stubDir) == 4);
+    REQUIRE(tablebases.generateTables(stubDir, std::vector<std::string>{"KPvKP"}, 4));
+
+    // Without en passant, h2h4 would win the race for white in the first position and g7g5 would win it for black
+    // in the second. Both double pushes are met by the en passant capture.
+    const std::vector<std::pair<std::string, TBResult>> positions = {
+        {"8/8/8/6p1/8/K7/7P/k7 w - - 0 1", TB_DRAW},
+        {"8/6p1/8/8/7P/1K6/8/4k3 w - - 0 1", TB_DRAW},
+        {"8/6K1/8/8/5p2/8/4P3/5k2 w - - 0 1", TB_LOSS},
+    };
+
+    for (const auto& [fen, expectedResult] : positions) {
+        Board board{};
+        TBResult result = TB_INVALID;
+
+        INFO(fen);
+        REQUIRE(board.setFromFEN(fen));
+        REQUIRE(tablebases.probe(board, result));
+        REQUIRE(result == expectedResult);
+    }
+
+    std::filesystem::remove_all(stubDir);
+}
+
+TEST_CASE("test_TablebaseLoadTables", "[tablebase]") {
+    const Tablebases& generatedTablebases = getGeneratedTablebases();
+    Tablebases tablebases{};
+    Board board{};
+    TBResult result = TB_INVALID;
+
+    REQUIRE(tablebases.loadTables(tablebaseDir) == 5);
+    REQUIRE(tablebases.getTableCount() == generatedTablebases.getTableCount());
+    REQUIRE(board.setFromFEN("8/8/8/4k3/8/4K3/4P3/8 b - - 0 1"));
+    REQUIRE(tablebases.probe(board, result));
+    REQUIRE(result == TB_LOSS);
+
+    // Already loaded tables are not generated again
+    REQUIRE(tablebases.generateTables(tablebaseDir, 3, 1, [](const std::string&, uint64_t) { FAIL(); }));
+
+    tablebases.clear();
+    REQUIRE_FALSE(tablebases.probe(board, result));
+    REQUIRE(tablebases.loadTables(tablebaseDir + "_missing") == 0);
+}
+} // namespace Zagreus
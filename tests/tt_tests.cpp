@@ -0,0 +1,286 @@
+/*
+ This file is part of Zagreus.
+
+ Zagreus is a UCI chess engine
+ Copyright (C) 2023-2025  Danny Jelsma
+
+ Zagreus is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published
+ by the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Zagreus is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with Zagreus.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../src/constants.h"
+#include "../src/tablebase.h"
+#include "../src/thread_pool.h"
+#include "../src/tt.h"
+#include "../src/uci.h"
+
+namespace Zagreus {
+// Every field of a stored entry is derived from the hash, so a reader can verify an entry it did not write itself
+static int16_t expectedScore(const uint64_t zobristHash) {
+    return static_cast<int16_t>(static_cast<int>((zobristHash >> 42) % 8000) - 4000);
+}
+
+static Move expectedMove(const uint64_t zobristHash) {
+    return static_cast<Move>((zobristHash >> 45) & 0xFFFF);
+}
+
+static int8_t expectedDepth(const uint64_t zobristHash) {
+    return static_cast<int8_t>(1 + (zobristHash >> 50) % 100);
+}
+
+TEST_CASE("test_TTPackedEntry", "[tt]") {
+    const std::unique_ptr<TranspositionTable> tt = std::make_unique<TranspositionTable>();
+    const uint64_t zobristHash = 0xDEADBEEFCAFEBABEULL;
+    TTEntry entry{};
+
+    tt->setTableSize(1);
+    REQUIRE_FALSE(tt->getEntry(zobristHash, entry));
+
+    tt->savePosition(zobristHash, -3, 0, -1234, 0xABCD, BETA);
+
+    REQUIRE(tt->getEntry(zobristHash, entry));
+    REQUIRE(entry.score == -1234);
+    REQUIRE(entry.bestMove == 0xABCD);
+    REQUIRE(entry.depth == -3);
+    REQUIRE(entry.nodeType == BETA);
+    // Same index, different validation key
+    REQUIRE_FALSE(tt->getEntry(zobristHash ^ 1, entry));
+}
+
+TEST_CASE("test_TTStaticEval", "[tt]") {
+    const std::unique_ptr<TranspositionTable> tt = std::make_unique<TranspositionTable>();
+    TTEntry entry{};
+    bool ttHit = false;
+    int16_t staticEval = 0;
+
+    tt->setTableSize(1);
+    tt->savePosition(0xABCD0001, 0, 0, 50, NO_MOVE, BETA, -321);
+    REQUIRE(tt->probePosition(0xABCD0001, 0, 0, 10, 0, ttHit, staticEval) == 50);
+    REQUIRE(ttHit);
+    REQUIRE(staticEval == -321);
+
+    // Saving the same position without an evaluation keeps the stored one
+    tt->savePosition(0xABCD0001, 2, 0, 60, NO_MOVE, EXACT);
+    REQUIRE(tt->getEntry(0xABCD0001, entry));
+    REQUIRE(entry.score == 60);
+    REQUIRE(entry.staticEval == -321);
+
+    // A different position in the same cluster does not get an evaluation
+    tt->savePosition(0xABCD0002, 1, 0, 0, NO_MOVE, EXACT);
+    REQUIRE(tt->getEntry(0xABCD0002, entry));
+    REQUIRE(entry.staticEval == NO_EVAL_SCORE);
+}
+
+TEST_CASE("test_TTStaticEvalClearedOnEvaluatorSwitch", "[tt]") {
+    TranspositionTable* tt = TranspositionTable::getTT();
+    Engine engine{};
+    ThreadPool threadPool(engine);
+    TTEntry entry{};
+
+    tt->setTableSize(1);
+    tt->savePosition(0xABCD0001, 3, 0, 50, NO_MOVE, EXACT, -321);
+    REQUIRE(tt->getEntry(0xABCD0001, entry));
+    REQUIRE(entry.staticEval == -321);
+
+    // The stored evaluation came from the other evaluator, the rest of the entry stays usable
+    threadPool.setUseNNUE(false);
+    REQUIRE(tt->getEntry(0xABCD0001, entry));
+    REQUIRE(entry.score == 50);
+    REQUIRE(entry.depth == 3);
+    REQUIRE(entry.staticEval == NO_EVAL_SCORE);
+}
+
+TEST_CASE("test_TTDistanceScores", "[tt]") {
+    const std::unique_ptr<TranspositionTable> tt = std::make_unique<TranspositionTable>();
+    bool ttHit = false;
+
+    tt->setTableSize(1);
+
+    // A tablebase win found at ply 10 is 6 plies away from a position saved at ply 4
+    tt->savePosition(0x1000, 5, 4, TB_WIN_SCORE - 10, NO_MOVE, EXACT);
+    REQUIRE(tt->probePosition(0x1000, 5, 0, 0, 4, ttHit) == TB_WIN_SCORE - 10);
+    REQUIRE(tt->probePosition(0x1000, 5, 0, 0, 8, ttHit) == TB_WIN_SCORE - 14);
+
+    tt->savePosition(0x2000, 5, 4, -TB_WIN_SCORE + 10, NO_MOVE, EXACT);
+    REQUIRE(tt->probePosition(0x2000, 5, 0, 0, 4, ttHit) == -TB_WIN_SCORE + 10);
+    REQUIRE(tt->probePosition(0x2000, 5, 0, 0, 8, ttHit) == -TB_WIN_SCORE + 14);
+
+    tt->savePosition(0x3000, 5, 4, MATE_SCORE - 10, NO_MOVE, EXACT);
+    REQUIRE(tt->probePosition(0x3000, 5, 0, 0, 4, ttHit) == MATE_SCORE - 10);
+    REQUIRE(tt->probePosition(0x3000, 5, 0, 0, 8, ttHit) == MATE_SCORE - 14);
+
+    tt->savePosition(0x4000, 5, 4, -MATE_SCORE + 10, NO_MOVE, EXACT);
+    REQUIRE(tt->probePosition(0x4000, 5, 0, 0, 2, ttHit) == -MATE_SCORE + 8);
+
+    // Normal scores are not ply dependent
+    tt->savePosition(0x5000, 5, 4, 300, NO_MOVE, EXACT);
+    REQUIRE(tt->probePosition(0x5000, 5, 0, 0, 8, ttHit) == 300);
+}
+
+TEST_CASE("test_TTClusterReplacement", "[tt]") {
+    const std::unique_ptr<TranspositionTable> tt = std::make_unique<TranspositionTable>();
+    TTEntry entry{};
+
+    tt->setTableSize(1);
+
+    // Fill one cluster, the deepest entry has the highest validation key
+    for (uint64_t i = 0; i < TT_CLUSTER_SIZE; ++i) {
+        tt->savePosition(i + 1, static_cast<int8_t>(10 + i), 0, 0, NO_MOVE, EXACT);
+    }
+
+    // A shallow entry of the same search replaces the shallowest entry
+    tt->savePosition(100ULL, 1, 0, 0, NO_MOVE, EXACT);
+    REQUIRE(tt->getEntry(100ULL, entry));
+    REQUIRE_FALSE(tt->getEntry(1ULL, entry));
+    REQUIRE(tt->getEntry(static_cast<uint64_t>(TT_CLUSTER_SIZE), entry));
+
+    // In a later search, every old entry can be replaced. The shallowest one goes first.
+    tt->newSearch();
+    tt->savePosition(101ULL, 5, 0, 0, NO_MOVE, EXACT);
+    REQUIRE(tt->getEntry(101ULL, entry));
+    REQUIRE(entry.depth == 5);
+    REQUIRE_FALSE(tt->getEntry(100ULL, entry));
+
+    // The new entry is not replaced by an entry of the same search that is more shallow
+    tt->savePosition(102ULL, 1, 0, 0, NO_MOVE, EXACT);
+    REQUIRE(tt->getEntry(101ULL, entry));
+    REQUIRE_FALSE(tt->getEntry(2ULL, entry));
+}
+
+TEST_CASE("test_TTNonPowerOfTwoSize", "[tt]") {
+    const std::unique_ptr<TranspositionTable> tt = std::make_unique<TranspositionTable>();
+    TTEntry entry{};
+
+    tt->setTableSize(3);
+    REQUIRE(tt->clusterCount == 3 * 1024 * 1024 / sizeof(TTCluster));
+    REQUIRE(tt->getHashFull() == 0);
+
+    // The highest hash has to map to the last cluster
+    tt->savePosition(UINT64_MAX, 1, 0, 0, NO_MOVE, EXACT);
+    REQUIRE(tt->getEntry(UINT64_MAX, entry));
+
+    // Fill the first cluster, which is part of the hashfull sample
+    for (uint64_t i = 0; i < TT_CLUSTER_SIZE; ++i) {
+        tt->savePosition(i + 1, 1, 0, 0, NO_MOVE, EXACT);
+    }
+
+    REQUIRE(tt->getHashFull() == 1);
+}
+
+TEST_CASE("test_TTSaveAndLoad", "[tt]") {
+    const std::unique_ptr<TranspositionTable> tt = std::make_unique<TranspositionTable>();
+    const std::string path = (std::filesystem::temp_directory_path() / "zagreus_tt_test.bin").string();
+    TTEntry entry{};
+
+    tt->setTableSize(3);
+    tt->savePosition(UINT64_MAX, 7, 0, 123, 0x1234, BETA);
+    tt->savePosition(42, 3, 0, -55, 0x4321, ALPHA);
+    REQUIRE(tt->saveToFile(path, tt->getGeneration()));
+
+    const std::unique_ptr<TranspositionTable> loadedTT = std::make_unique<TranspositionTable>();
+
+    loadedTT->setTableSize(1);
+    REQUIRE(loadedTT->loadFromFile(path));
+    REQUIRE(loadedTT->clusterCount == tt->clusterCount);
+    REQUIRE(loadedTT->getEntry(UINT64_MAX, entry));
+    REQUIRE(entry.score == 123);
+    REQUIRE(entry.bestMove == 0x1234);
+    REQUIRE(entry.depth == 7);
+    REQUIRE(entry.nodeType == BETA);
+    REQUIRE(loadedTT->getEntry(42, entry));
+    REQUIRE(entry.score == -55);
+
+    // The loaded table can be written to without changing the file
+    loadedTT->savePosition(43, 3, 0, 0, NO_MOVE, EXACT);
+    REQUIRE(loadedTT->getEntry(43, entry));
+    REQUIRE(tt->loadFromFile(path));
+    REQUIRE_FALSE(tt->getEntry(43, entry));
+
+    // A file with a different layout is rejected
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    REQUIRE_FALSE(loadedTT->loadFromFile(path));
+    REQUIRE(loadedTT->getEntry(43, entry));
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("test_TTConcurrentAccess", "[tt]") {
+    const std::unique_ptr<TranspositionTable> tt = std::make_unique<TranspositionTable>();
+    constexpr int threadCount = 8;
+    constexpr int iterations = 200000;
+    std::vector<uint64_t> hashes{};
+    std::atomic<int> corruptedEntries = 0;
+    std::atomic<int> hits = 0;
+    std::vector<std::thread> threads{};
+    std::mt19937_64 random(12345);
+
+    tt->setTableSize(1);
+
+    // Many different positions that all map to the same few table indices, so the threads constantly overwrite each
+    // other's entries. Every position gets its own validation key.
+    for (uint64_t i = 0; i < 256; ++i) {
+        hashes.push_back((i & 0x3) << 62 | (random() & 0xFFFFFFF0000ULL) | (i + 1));
+    }
+
+    for (int threadId = 0; threadId < threadCount; ++threadId) {
+        threads.emplace_back([&tt, &hashes, &corruptedEntries, &hits, threadId] {
+            std::mt19937_64 threadRandom(threadId);
+
+            for (int i = 0; i < iterations; ++i) {
+                const uint64_t zobristHash = hashes[threadRandom() % hashes.size()];
+
+                if (threadRandom() & 1) {
+                    tt->savePosition(zobristHash, expectedDepth(zobristHash), 0, expectedScore(zobristHash),
+                                     expectedMove(zobristHash), EXACT);
+                    continue;
+                }
+
+                TTEntry entry{};
+
+                if (!tt->getEntry(zobristHash, entry)) {
+                    continue;
+                }
+
+                hits.fetch_add(1, std::memory_order_relaxed);
+
+                if (entry.score != expectedScore(zobristHash) || entry.bestMove != expectedMove(zobristHash)
+                    || entry.depth != expectedDepth(zobristHash) || entry.nodeType != EXACT) {
+                    corruptedEntries.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                bool ttHit = false;
+                const int16_t score = tt->probePosition(zobristHash, 0, -30000, 30000, 0, ttHit);
+
+                if (score != NO_TT_SCORE && score != expectedScore(zobristHash)) {
+                    corruptedEntries.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(hits > 0);
+    REQUIRE(corruptedEntries == 0);
+}
+} // namespace Zagreus